@@ -58,13 +58,17 @@ struct {
 int
 consolewrite(int user_src, uint64 src, int n)
 {
-  int i;
-
-  for(i = 0; i < n; i++){
-    char c;
-    if(either_copyin(&c, user_src, src+i, 1) == -1)
+  char buf[128];
+  int i, m;
+
+  // copy and queue a chunk at a time.
+  for(i = 0; i < n; i += m){
+    m = n - i;
+    if(m > sizeof(buf))
+      m = sizeof(buf);
+    if(either_copyin(buf, user_src, src+i, m) == -1)
       break;
-    uartputc(c);
+    uartwrite(buf, m);
   }
 
   return i;
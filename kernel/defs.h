@@ -1,13 +1,17 @@
 struct buf;
 struct context;
+struct dirent;
 struct file;
 struct inode;
+struct iovec;
+struct kcache;
 struct pipe;
 struct proc;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vma;
 
 // bio.c
 void            binit(void);
@@ -22,6 +26,12 @@ void            consoleinit(void);
 void            consoleintr(int);
 void            consputc(int);
 
+// kmsg.c
+void            kmsginit(void);
+void            kmsglog(char*, int);
+void            kmsgdrain(void);
+void            kmsgflushsync(void);
+
 // exec.c
 int             exec(char*, char**);
 
@@ -32,12 +42,19 @@ struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
+int             filegetdents(struct file*, uint64 addr, int n);
 int             filewrite(struct file*, uint64, int n);
+int             filesend(struct file*, struct file*, uint*, int n);
+int             filepread(struct file*, uint64, int n, uint off);
+int             filepwrite(struct file*, uint64, int n, uint off);
+int             filereadv(struct file*, struct iovec*, int cnt);
+int             filewritev(struct file*, struct iovec*, int cnt);
 
 // fs.c
 void            fsinit(int);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+struct inode*   dirnext(struct inode*, uint*, struct dirent*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
@@ -49,10 +66,14 @@ void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
+struct inode*   nameiat(struct inode*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
+uint64          itext(struct inode*, uint, uint, int);
+void            itextdrop(struct inode*);
+int             itextreclaim(void);
 
 // ramdisk.c
 void            ramdiskinit(void);
@@ -63,6 +84,15 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           superalloc(void);
+void            superfree(void *);
+void            kref(void *);
+int             krefs(void *);
+
+// slab.c
+void            kcacheinit(struct kcache*, char*, uint);
+void*           kcachealloc(struct kcache*);
+void            kcachefree(struct kcache*, void*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -74,22 +104,38 @@ void            end_op(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             pipewrite(struct pipe*, int, uint64, int);
 
 // printf.c
 int            printf(char*, ...) __attribute__ ((format (printf, 1, 2)));
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
+// prof.c
+extern int      profon;
+void            profinit(void);
+int             profctl(int);
+void            profsample(int, uint64, uint64);
+int             profread(uint64, int);
+
+// trace.c
+struct tracerec;
+void            traceinit(void);
+int             tracelog(struct tracerec*);
+int             traceread(uint64, int);
+
 // proc.c
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
 int             growproc(int);
-void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
+uint64          proc_satp(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
+int             proc_ring(struct proc*);
 int             kill(int);
+int             tracecount(int, int);
+int             traceattach(int, uint64);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
 struct cpu*     mycpu(void);
@@ -140,40 +186,64 @@ void            argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+int             sysstatread(uint64, int);
+
+// vector.S, with make RVV=1
+void            vsave(char*);
+void            vrestore(char*);
+uint64          vlenb(void);
 
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
+extern struct ushared *ushared;
 void            usertrapret(void);
 
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
+void            uartwrite(char*, int);
+int             uarttrywrite(char*, int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
 // vm.c
+extern uint64   asidmax;
 void            kvminit(void);
 void            kvminithart(void);
+int             kvmmapstack(uint64);
+void            kvmunmapstack(uint64);
+void            kvmsync(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvmfirst(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
+int             uvmsplit(pagetable_t, uint64);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
+pte_t *         walkpage(pagetable_t, uint64, uint64 *);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 
+// vma.c
+struct vma*     vmafind(struct proc*, uint64, uint64);
+uint64          vmamap(struct proc*, struct file*, uint64, int, int, uint);
+int             vmaunmap(struct proc*, uint64, uint64);
+void            vmafree(struct proc*);
+int             vmacopy(struct proc*, struct proc*);
+int             vmafault(struct proc*, uint64, uint64);
+int             vmaprefault(struct proc*, uint64, uint64, int);
+
 // plic.c
 void            plicinit(void);
 void            plicinithart(void);
@@ -8,6 +8,7 @@
 #include "elf.h"
 
 static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
+static int maptext(pde_t *, uint64, struct inode *, uint, uint, uint, int, uint64 *);
 
 int flags2perm(int flags)
 {
@@ -61,6 +62,15 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
+    if((ph.flags & ELF_PROG_FLAG_WRITE) == 0 && ph.off % PGSIZE == 0 &&
+       ph.vaddr >= PGROUNDUP(sz)){
+      // read-only: share the pages with other
+      // processes running this program.
+      if(maptext(pagetable, ph.vaddr, ip, ph.off, ph.filesz, ph.memsz,
+                 flags2perm(ph.flags), &sz) < 0)
+        goto bad;
+      continue;
+    }
     uint64 sz1;
     if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz, flags2perm(ph.flags))) == 0)
       goto bad;
@@ -120,12 +130,20 @@ exec(char *path, char **argv)
       last = s+1;
   safestrcpy(p->name, last, sizeof(p->name));
     
-  // Commit to the user image.
+  // Commit to the user image. Mappings of files don't
+  // survive exec; unmap them while p->pagetable is old.
+  vmafree(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  p->asid = 0;           // new address space, new ASID
+  p->ring = 0;           // freed with the old page table
+  if(p->vstate){         // the new program starts without vectors
+    kfree(p->vstate);
+    p->vstate = 0;
+  }
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
@@ -140,6 +158,45 @@ exec(char *path, char **argv)
   return -1;
 }
 
+// Map a read-only program segment into pagetable at virtual
+// address va, using pages from ip's text cache, after
+// allocating any gap between *sz and va. va and offset
+// must be page-aligned. Advances *sz as pages are mapped,
+// so that the caller can free them on failure.
+// Returns 0 on success, -1 on failure.
+static int
+maptext(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset,
+        uint filesz, uint memsz, int perm, uint64 *sz)
+{
+  uint i, n;
+  uint64 pa;
+
+  if(va > *sz){
+    if(uvmalloc(pagetable, *sz, va, 0) == 0)
+      return -1;
+    *sz = va;
+  }
+
+  for(i = 0; i < memsz; i += PGSIZE){
+    if(i < filesz){
+      n = filesz - i < PGSIZE ? filesz - i : PGSIZE;
+      if((pa = itext(ip, offset+i, n, 1)) == 0)
+        return -1;
+    } else {
+      if((pa = (uint64)kalloc()) == 0)
+        return -1;
+      memset((void*)pa, 0, PGSIZE);
+    }
+    if(mappages(pagetable, va + i, PGSIZE, pa, PTE_R|PTE_U|perm) != 0){
+      kfree((void*)pa);
+      return -1;
+    }
+    *sz = va + i + PGSIZE;
+  }
+  *sz = va + memsz;
+  return 0;
+}
+
 // Load a program segment into pagetable at virtual address va.
 // va must be page-aligned
 // and the pages from va to va+sz must already be mapped.
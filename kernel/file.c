@@ -12,6 +12,13 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "uio.h"
+
+// write a few blocks at a time to avoid exceeding
+// the maximum log transaction size, including
+// i-node, indirect block, allocation blocks,
+// and 2 blocks of slop for non-aligned writes.
+#define MAXWRITE (((MAXOPBLOCKS-1-1-2) / 2) * BSIZE)
 
 struct devsw devsw[NDEV];
 struct {
@@ -101,6 +108,57 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// Read up to n entries of directory f, each with its inode's
+// type and size, into an array of struct dirstat at user
+// address addr. Returns the number read, 0 at the end.
+int
+filegetdents(struct file *f, uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct inode *dp = f->ip, *ip;
+  struct dirstat *ds;
+  struct dirent de;
+  int i;
+
+  if(f->type != FD_INODE || f->readable == 0 || n < 0)
+    return -1;
+  if(n > PGSIZE / sizeof(*ds))
+    n = PGSIZE / sizeof(*ds);
+  if((ds = (struct dirstat*)kalloc()) == 0)
+    return -1;
+
+  begin_op();
+  for(i = 0; i < n; i++){
+    ilock(dp);
+    if(dp->type != T_DIR){
+      iunlock(dp);
+      end_op();
+      kfree(ds);
+      return -1;
+    }
+    ip = dirnext(dp, &f->off, &de);
+    iunlock(dp);
+    if(ip == 0)
+      break;
+    // dp is unlocked first: ip may be dp itself (".")
+    // or its parent, which is locked before its children.
+    ilock(ip);
+    ds[i].ino = ip->inum;
+    ds[i].type = ip->type;
+    ds[i].nlink = ip->nlink;
+    ds[i].size = ip->size;
+    iunlockput(ip);
+    memmove(ds[i].name, de.name, DIRSIZ);
+    ds[i].name[DIRSIZ] = 0;
+  }
+  end_op();
+
+  if(i > 0 && copyout(p->pagetable, addr, (char*)ds, i * sizeof(*ds)) < 0)
+    i = -1;
+  kfree(ds);
+  return i;
+}
+
 // Read from file f.
 // addr is a user virtual address.
 int
@@ -110,6 +168,10 @@ fileread(struct file *f, uint64 addr, int n)
 
   if(f->readable == 0)
     return -1;
+  // the copy is made holding the pipe's, device's or inode's
+  // lock, so fault any mapped pages in first.
+  if(vmaprefault(myproc(), addr, n, 1) < 0)
+    return -1;
 
   if(f->type == FD_PIPE){
     r = piperead(f->pipe, addr, n);
@@ -129,54 +191,227 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
-// Write to file f.
-// addr is a user virtual address.
-int
-filewrite(struct file *f, uint64 addr, int n)
+// Write n bytes from addr to inode ip at *off, and
+// advance *off, at most MAXWRITE bytes per transaction.
+// this really belongs lower down, since writei()
+// might be writing a device like the console.
+static int
+writeinode(struct inode *ip, int user_src, uint64 addr, uint *off, int n)
+{
+  int r = 0, i = 0;
+
+  while(i < n){
+    int n1 = n - i;
+    if(n1 > MAXWRITE)
+      n1 = MAXWRITE;
+
+    begin_op();
+    ilock(ip);
+    if ((r = writei(ip, user_src, addr + i, *off, n1)) > 0)
+      *off += r;
+    iunlock(ip);
+    end_op();
+
+    if(r != n1){
+      // error from writei
+      break;
+    }
+    i += r;
+  }
+  return (i == n ? n : -1);
+}
+
+// Write to file f from addr, a user virtual
+// address if user_src is set, else a kernel address.
+static int
+writefrom(struct file *f, int user_src, uint64 addr, int n)
 {
-  int r, ret = 0;
+  int ret = 0;
 
   if(f->writable == 0)
     return -1;
+  if(user_src && vmaprefault(myproc(), addr, n, 0) < 0)
+    return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, user_src, addr, n);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    ret = devsw[f->major].write(user_src, addr, n);
   } else if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
+    ret = writeinode(f->ip, user_src, addr, &f->off, n);
+  } else {
+    panic("filewrite");
+  }
+
+  return ret;
+}
+
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  return writefrom(f, 1, addr, n);
+}
+
+// Read n bytes at offset off of the inode open as f,
+// leaving f's offset alone. addr is a user virtual address.
+int
+filepread(struct file *f, uint64 addr, int n, uint off)
+{
+  int r;
+
+  if(f->type != FD_INODE || f->readable == 0)
+    return -1;
+  if(vmaprefault(myproc(), addr, n, 1) < 0)
+    return -1;
+  ilock(f->ip);
+  r = readi(f->ip, 1, addr, off, n);
+  iunlock(f->ip);
+  return r;
+}
+
+// Write n bytes at offset off of the inode open as f,
+// leaving f's offset alone. addr is a user virtual address.
+int
+filepwrite(struct file *f, uint64 addr, int n, uint off)
+{
+  if(f->type != FD_INODE || f->writable == 0)
+    return -1;
+  if(vmaprefault(myproc(), addr, n, 0) < 0)
+    return -1;
+  return writeinode(f->ip, 1, addr, &off, n);
+}
+
+// Read into the cnt buffers of iov in turn, stopping at
+// a short read. An inode is read under one lock, so the
+// buffers get consecutive data even if others share f.
+int
+filereadv(struct file *f, struct iovec *iov, int cnt)
+{
+  int i, r = 0, total = 0;
+
+  if(f->readable == 0)
+    return -1;
+  for(i = 0; i < cnt; i++)
+    if(vmaprefault(myproc(), (uint64)iov[i].iov_base, iov[i].iov_len, 1) < 0)
+      return -1;
+  if(f->type == FD_INODE)
+    ilock(f->ip);
+  for(i = 0; i < cnt; i++){
+    if(f->type == FD_INODE){
+      if((r = readi(f->ip, 1, (uint64)iov[i].iov_base, f->off, iov[i].iov_len)) > 0)
         f->off += r;
-      iunlock(f->ip);
-      end_op();
+    } else {
+      r = fileread(f, (uint64)iov[i].iov_base, iov[i].iov_len);
+    }
+    if(r < 0)
+      break;
+    total += r;
+    if(r != iov[i].iov_len)
+      break;
+  }
+  if(f->type == FD_INODE)
+    iunlock(f->ip);
+  return (r < 0 && total == 0) ? -1 : total;
+}
 
-      if(r != n1){
-        // error from writei
-        break;
+// Write the cnt buffers of iov in turn. To an inode, up to
+// MAXWRITE bytes in all go in one transaction, so a crash
+// leaves all of them or none, and a reader of f's inode sees
+// none until all are written. Returns the number of bytes
+// written, short if a write fails partway, or -1 if none.
+int
+filewritev(struct file *f, struct iovec *iov, int cnt)
+{
+  int i, r = 0, total = 0;
+
+  if(f->writable == 0)
+    return -1;
+  for(i = 0; i < cnt; i++){
+    if(vmaprefault(myproc(), (uint64)iov[i].iov_base, iov[i].iov_len, 0) < 0)
+      return -1;
+    total += iov[i].iov_len;
+  }
+
+  if(f->type == FD_INODE && total <= MAXWRITE){
+    total = 0;
+    begin_op();
+    ilock(f->ip);
+    for(i = 0; i < cnt; i++){
+      if((r = writei(f->ip, 1, (uint64)iov[i].iov_base, f->off, iov[i].iov_len)) > 0){
+        f->off += r;
+        total += r;
       }
-      i += r;
+      if(r != iov[i].iov_len)
+        break;
     }
-    ret = (i == n ? n : -1);
-  } else {
-    panic("filewrite");
+    iunlock(f->ip);
+    end_op();
+    return (i < cnt && total == 0) ? -1 : total;
   }
 
-  return ret;
+  total = 0;
+  for(i = 0; i < cnt; i++){
+    r = filewrite(f, (uint64)iov[i].iov_base, iov[i].iov_len);
+    if(r < 0)
+      return total > 0 ? total : -1;
+    total += r;
+    if(r != iov[i].iov_len)
+      break;
+  }
+  return total;
+}
+
+// Copy up to n bytes of the inode open as in, starting at
+// *off, to out, and advance *off. The data goes from the
+// buffer cache through a kernel page, never user memory.
+// The page lets in be unlocked while writing to out, which
+// may sleep on a full pipe, or be the same inode.
+// Returns the number of bytes copied, or -1.
+int
+filesend(struct file *out, struct file *in, uint *off, int n)
+{
+  char *buf;
+  int r, w, m, total = 0;
+  uint start;
+
+  if(in->type != FD_INODE || in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+  if((buf = kalloc()) == 0)
+    return -1;
+
+  while(total < n){
+    m = n - total;
+    if(m > PGSIZE)
+      m = PGSIZE;
+    // advance *off under the lock, as fileread() does, so
+    // others sharing in don't read the same bytes.
+    ilock(in->ip);
+    start = *off;
+    if((r = readi(in->ip, 0, (uint64)buf, start, m)) > 0)
+      *off = start + r;
+    iunlock(in->ip);
+    if(r <= 0)
+      break;
+    w = writefrom(out, 0, (uint64)buf, r);
+    if(w > 0)
+      total += w;
+    if(w != r){
+      // give back what wasn't written, unless someone
+      // sharing in has read past it since.
+      ilock(in->ip);
+      if(*off == start + r)
+        *off = start + (w > 0 ? w : 0);
+      iunlock(in->ip);
+      if(total == 0)
+        total = -1;
+      break;
+    }
+  }
+  kfree(buf);
+  return total;
 }
 
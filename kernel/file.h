@@ -18,6 +18,7 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct textpage *text; // cached read-only exec pages, under textlock
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -38,3 +39,4 @@ struct devsw {
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define KMSG    2
@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
@@ -140,7 +141,9 @@ bfree(int dev, uint b)
 //   table entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
 //   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   ip->valid if it frees the inode. An entry whose ref
+//   has fallen to zero keeps its contents until iget()
+//   recycles it, so iget() of the same inode can reuse it.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -170,14 +173,35 @@ bfree(int dev, uint b)
 // holds, one must hold itable.lock while using any of those fields.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
-// dev, and inum.  One must hold ip->lock in order to
+// dev, inum, and text.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+//
+// ip->text caches pages of the inode's content for exec() to
+// map read-only into every process that runs it, and mmap()
+// to map shared; see itext(). writei() keeps the shared ones
+// up to date.
 
 struct {
   struct spinlock lock;
   struct inode inode[NINODE];
 } itable;
 
+// a cached page: n bytes of file content from off,
+// then zeros. the cache holds one reference to the
+// physical page, and each mapping of it another.
+struct textpage {
+  struct textpage *next;
+  uint off;
+  uint n;
+  uint64 pa;
+  int frozen;       // mapped by exec() or MAP_PRIVATE; see itextwrite()
+};
+
+// protects every inode's text list. kalloc() takes it, via
+// itextreclaim(), so it must not be held while allocating.
+struct spinlock textlock;
+static struct kcache textcache;
+
 void
 iinit()
 {
@@ -187,9 +211,12 @@ iinit()
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
+  initlock(&textlock, "text");
+  kcacheinit(&textcache, "textpage", sizeof(struct textpage));
 }
 
 static struct inode* iget(uint dev, uint inum);
+static void itextwrite(struct inode*, uint, uchar*, uint);
 
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
@@ -250,10 +277,12 @@ iget(uint dev, uint inum)
 
   acquire(&itable.lock);
 
-  // Is the inode already in the table?
+  // Is the inode already in the table? An unreferenced
+  // entry still holds the inode (and its text pages)
+  // until it is recycled.
   empty = 0;
   for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
       return ip;
@@ -267,6 +296,7 @@ iget(uint dev, uint inum)
     panic("iget: no inodes");
 
   ip = empty;
+  itextdrop(ip);
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
@@ -450,6 +480,153 @@ itrunc(struct inode *ip)
 
   ip->size = 0;
   iupdate(ip);
+  itextdrop(ip);
+}
+
+// Return the physical address of a page holding n bytes
+// of ip's content from off followed by zeros, for exec()
+// to map read-only, and take a reference to it for the
+// caller's mapping. Repeated calls with the same off and n
+// return the same page without reading the disk. frozen
+// says the caller's mapping must keep the content it has
+// now, whatever is later written to the file.
+// Returns 0 if out of memory or the read fails.
+// Caller must hold ip->lock.
+uint64
+itext(struct inode *ip, uint off, uint n, int frozen)
+{
+  struct textpage *t;
+  char *mem;
+
+  acquire(&textlock);
+  for(t = ip->text; t; t = t->next){
+    if(t->off == off && t->n == n){
+      t->frozen |= frozen;
+      kref((void*)t->pa);
+      release(&textlock);
+      return t->pa;
+    }
+  }
+  release(&textlock);
+
+  if((t = kcachealloc(&textcache)) == 0)
+    return 0;
+  if((mem = kalloc()) == 0){
+    kcachefree(&textcache, t);
+    return 0;
+  }
+  memset(mem + n, 0, PGSIZE - n);
+  if(readi(ip, 0, (uint64)mem, off, n) != n){
+    kfree(mem);
+    kcachefree(&textcache, t);
+    return 0;
+  }
+  t->off = off;
+  t->n = n;
+  t->pa = (uint64)mem;
+  t->frozen = frozen;
+  kref(mem);  // one reference for the cache, one for the caller
+
+  // holding ip->lock, so no one else can have added this page.
+  acquire(&textlock);
+  t->next = ip->text;
+  ip->text = t;
+  release(&textlock);
+  return t->pa;
+}
+
+// Forget ip's cached text pages, because its content is
+// changing or the table entry is being recycled. Processes
+// that have them mapped keep their references.
+void
+itextdrop(struct inode *ip)
+{
+  struct textpage *t, *list;
+
+  acquire(&textlock);
+  list = ip->text;
+  ip->text = 0;
+  release(&textlock);
+
+  while((t = list) != 0){
+    list = t->next;
+    kfree((void*)t->pa);
+    kcachefree(&textcache, t);
+  }
+}
+
+// Copy n bytes just written at off into ip's cached pages
+// that hold them, so pages mapped shared stay the file's
+// content. A frozen page, which a running program or a
+// private mapping must not see change, is dropped from the
+// cache instead, as is a page cut short by the end of a
+// segment or of the file if the write reaches past its n,
+// since it must stay zero there. Processes that have a
+// dropped page mapped keep the old copy.
+// Caller must hold ip->lock.
+static void
+itextwrite(struct inode *ip, uint off, uchar *src, uint n)
+{
+  struct textpage *t, **tp, *list = 0;
+  uint lo, hi;
+
+  acquire(&textlock);
+  for(tp = &ip->text; (t = *tp) != 0; ){
+    if(off + n <= t->off || t->off + PGSIZE <= off){
+      tp = &t->next;
+      continue;
+    }
+    if(t->frozen || off + n > t->off + t->n){
+      *tp = t->next;
+      t->next = list;
+      list = t;
+      continue;
+    }
+    lo = off > t->off ? off : t->off;
+    hi = off + n;
+    memmove((char*)t->pa + (lo - t->off), src + (lo - off), hi - lo);
+    tp = &t->next;
+  }
+  release(&textlock);
+
+  while((t = list) != 0){
+    list = t->next;
+    kfree((void*)t->pa);
+    kcachefree(&textcache, t);
+  }
+}
+
+// Free the cached text pages that no process has mapped.
+// Called by kalloc() when memory runs out.
+// Returns the number of pages freed.
+int
+itextreclaim(void)
+{
+  struct inode *ip;
+  struct textpage *t, **tp, *list = 0;
+  int n = 0;
+
+  acquire(&textlock);
+  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
+    for(tp = &ip->text; (t = *tp) != 0; ){
+      if(krefs((void*)t->pa) == 1){
+        *tp = t->next;
+        t->next = list;
+        list = t;
+      } else {
+        tp = &t->next;
+      }
+    }
+  }
+  release(&textlock);
+
+  while((t = list) != 0){
+    list = t->next;
+    kfree((void*)t->pa);
+    kcachefree(&textcache, t);
+    n++;
+  }
+  return n;
 }
 
 // Copy stat information from inode.
@@ -524,6 +701,8 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
       break;
     }
     log_write(bp);
+    if(ip->text)
+      itextwrite(ip, off, bp->data + (off % BSIZE), m);
     brelse(bp);
   }
 
@@ -574,6 +753,27 @@ dirlookup(struct inode *dp, char *name, uint *poff)
   return 0;
 }
 
+// Read the first entry in use at or after offset *poff in
+// directory dp into de, and set *poff just past it.
+// Returns the entry's inode, referenced but not locked,
+// or 0 at the end of the directory.
+struct inode*
+dirnext(struct inode *dp, uint *poff, struct dirent *de)
+{
+  if(dp->type != T_DIR)
+    panic("dirnext not DIR");
+
+  for(; *poff < dp->size; *poff += sizeof(*de)){
+    if(readi(dp, 0, (uint64)de, *poff, sizeof(*de)) != sizeof(*de))
+      panic("dirnext read");
+    if(de->inum != 0){
+      *poff += sizeof(*de);
+      return iget(dp->dev, de->inum);
+    }
+  }
+  return 0;
+}
+
 // Write a new directory entry (name, inum) into the directory dp.
 // Returns 0 on success, -1 on failure (e.g. out of disk blocks).
 int
@@ -647,16 +847,17 @@ skipelem(char *path, char *name)
 // Look up and return the inode for a path name.
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
+// Relative paths start from directory dp.
 // Must be called inside a transaction since it calls iput().
 static struct inode*
-namex(char *path, int nameiparent, char *name)
+namex(struct inode *dp, char *path, int nameiparent, char *name)
 {
   struct inode *ip, *next;
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
   else
-    ip = idup(myproc()->cwd);
+    ip = idup(dp);
 
   while((path = skipelem(path, name)) != 0){
     ilock(ip);
@@ -687,11 +888,20 @@ struct inode*
 namei(char *path)
 {
   char name[DIRSIZ];
-  return namex(path, 0, name);
+  return namex(myproc()->cwd, path, 0, name);
 }
 
 struct inode*
 nameiparent(char *path, char *name)
 {
-  return namex(path, 1, name);
+  return namex(myproc()->cwd, path, 1, name);
+}
+
+// Look up path relative to directory dp
+// rather than the current directory.
+struct inode*
+nameiat(struct inode *dp, char *path)
+{
+  char name[DIRSIZ];
+  return namex(dp, path, 0, name);
 }
@@ -1,6 +1,16 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// and 2-megabyte superpages for large user regions.
+//
+// Each page has a reference count, so that a page can be
+// mapped by several processes (e.g. shared program text);
+// kfree() only frees a page when its last reference goes.
+//
+// kalloc() breaks up a superpage when it runs out of ordinary
+// pages, and kfree() puts one back together once all 512 of
+// its pages are free again, so that superpages don't all wear
+// away into ordinary pages.
 
 #include "types.h"
 #include "param.h"
@@ -16,13 +26,69 @@ extern char end[]; // first address after kernel.
 
 struct run {
   struct run *next;
+  struct run *prev;      // on freelist only
 };
 
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define PA2FRAME(pa) (((uint64)(pa) - KERNBASE) / SUPERPGSIZE)
+#define NPERSUPER (SUPERPGSIZE / PGSIZE)
+
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *freelist;  // doubly linked, to take out a superpage's pages
+  int nfree;             // pages on freelist
+  struct run *superlist; // free superpages, SUPERPGSIZE-aligned
+  int ref[PA2REF(PHYSTOP)]; // references to each allocated page
+  short framefree[PA2FRAME(PHYSTOP)]; // pages of each superpage on freelist
 } kmem;
 
+// Put page r on the free list. Caller holds kmem.lock.
+static void
+pushfree(struct run *r)
+{
+  r->prev = 0;
+  r->next = kmem.freelist;
+  if(r->next)
+    r->next->prev = r;
+  kmem.freelist = r;
+  kmem.nfree++;
+  kmem.framefree[PA2FRAME(r)]++;
+}
+
+// Take page r off the free list. Caller holds kmem.lock.
+static void
+unfree(struct run *r)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelist = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nfree--;
+  kmem.framefree[PA2FRAME(r)]--;
+}
+
+// If every page of the superpage holding pa is free, and
+// there are ordinary pages to spare, move the superpage
+// from the free list to superlist. Caller holds kmem.lock.
+static void
+coalesce(void *pa)
+{
+  char *p, *s = (char*)(PGROUNDDOWN((uint64)pa) & ~(SUPERPGSIZE-1));
+  struct run *r;
+
+  if(kmem.framefree[PA2FRAME(s)] != NPERSUPER || kmem.nfree < 2*NPERSUPER)
+    return;
+  if(s < end || (uint64)s + SUPERPGSIZE > PHYSTOP)
+    return;
+  for(p = s; p < s + SUPERPGSIZE; p += PGSIZE)
+    unfree((struct run*)p);
+  r = (struct run*)s;
+  r->next = kmem.superlist;
+  kmem.superlist = r;
+}
+
 void
 kinit()
 {
@@ -30,19 +96,31 @@ kinit()
   freerange(end, (void*)PHYSTOP);
 }
 
+// Free the memory from pa_start to pa_end, as
+// superpages where it is suitably aligned, and
+// as ordinary pages elsewhere.
 void
 freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+  while(p + PGSIZE <= (char*)pa_end){
+    if((uint64)p % SUPERPGSIZE == 0 && p + SUPERPGSIZE <= (char*)pa_end){
+      superfree(p);
+      p += SUPERPGSIZE;
+    } else {
+      kmem.ref[PA2REF(p)] = 1;
+      kfree(p);
+      p += PGSIZE;
+    }
+  }
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Drop a reference to the page of physical memory pointed
+// at by pa, which normally should have been returned by a
+// call to kalloc(), and free it if that was the last one.
+// (The exception is when initializing the allocator;
+// see kinit above.)
 void
 kfree(void *pa)
 {
@@ -51,32 +129,128 @@ kfree(void *pa)
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  acquire(&kmem.lock);
+  if(kmem.ref[PA2REF(pa)] <= 0)
+    panic("kfree: ref");
+  if(--kmem.ref[PA2REF(pa)] > 0){
+    release(&kmem.lock);
+    return;
+  }
+  release(&kmem.lock);
+
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
   r = (struct run*)pa;
 
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  pushfree(r);
+  coalesce(pa);
   release(&kmem.lock);
 }
 
-// Allocate one 4096-byte page of physical memory.
+// Take another reference to the allocated page at pa.
+void
+kref(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kref");
+
+  acquire(&kmem.lock);
+  if(kmem.ref[PA2REF(pa)] <= 0)
+    panic("kref: free page");
+  kmem.ref[PA2REF(pa)]++;
+  release(&kmem.lock);
+}
+
+// Return the number of references to the page at pa.
+int
+krefs(void *pa)
+{
+  return __atomic_load_n(&kmem.ref[PA2REF(pa)], __ATOMIC_RELAXED);
+}
+
+// Allocate one 4096-byte page of physical memory,
+// with one reference.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
 void *
 kalloc(void)
 {
   struct run *r;
+  char *p;
+
+  for(;;){
+    acquire(&kmem.lock);
+    if(kmem.freelist == 0 && (r = kmem.superlist) != 0){
+      // out of ordinary pages: break up a superpage.
+      kmem.superlist = r->next;
+      for(p = (char*)r; p < (char*)r + SUPERPGSIZE; p += PGSIZE)
+        pushfree((struct run*)p);
+    }
+    r = kmem.freelist;
+    if(r){
+      unfree(r);
+      kmem.ref[PA2REF(r)] = 1;
+    }
+    release(&kmem.lock);
+
+    // out of memory: take back cached program text
+    // that no process is using, and try again.
+    if(r || itextreclaim() == 0)
+      break;
+  }
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
   if(r)
-    kmem.freelist = r->next;
+    memset((char*)r, 5, PGSIZE); // fill with junk
+  return (void*)r;
+}
+
+// Free the superpage of physical memory at pa,
+// which normally should have been returned by
+// superalloc().
+void
+superfree(void *pa)
+{
+  struct run *r;
+
+  if(((uint64)pa % SUPERPGSIZE) != 0 || (char*)pa < end ||
+     (uint64)pa + SUPERPGSIZE > PHYSTOP)
+    panic("superfree");
+
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, SUPERPGSIZE);
+
+  r = (struct run*)pa;
+
+  acquire(&kmem.lock);
+  for(int i = 0; i < SUPERPGSIZE/PGSIZE; i++)
+    kmem.ref[PA2REF(pa) + i] = 0;
+  r->next = kmem.superlist;
+  kmem.superlist = r;
+  release(&kmem.lock);
+}
+
+// Allocate one SUPERPGSIZE-aligned superpage.
+// Returns 0 if none is free; the caller should
+// then make do with ordinary pages.
+void *
+superalloc(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  r = kmem.superlist;
+  if(r){
+    kmem.superlist = r->next;
+    // the pages can be freed one at a time
+    // if the superpage is later split.
+    for(int i = 0; i < SUPERPGSIZE/PGSIZE; i++)
+      kmem.ref[PA2REF(r) + i] = 1;
+  }
   release(&kmem.lock);
 
   if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+    memset((char*)r, 5, SUPERPGSIZE); // fill with junk
   return (void*)r;
 }
@@ -0,0 +1,282 @@
+//
+// Kernel log. printf() appends each message to a ring of
+// records belonging to the current CPU, without taking a
+// lock, and the records are sent to the UART afterwards,
+// as room opens up in its transmit buffer, so that printf()
+// never waits for the UART. Reading the KMSG device returns
+// the log with timestamps, oldest first.
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "defs.h"
+#include "proc.h"
+
+#define NKMSG 64    // records per CPU
+
+struct kmsgrec {
+  uint64 time;      // r_time() when logged
+  uint len;
+  uint cont;        // continues the line of the previous record
+  char text[KMSGTEXT];
+};
+
+// records k->rec[i % NKMSG] for i < k->w have been logged.
+// only this CPU writes new ones, and only over records that
+// have already been sent; readers of the device may still
+// find one overwritten, and skip it.
+struct kmsgcpu {
+  struct kmsgrec rec[NKMSG];
+  uint64 w;         // records logged
+  uint64 sent;      // records sent to the uart
+  uint sentoff;     // bytes of rec[sent] sent so far
+  uint64 rd;        // next record for readers of the device
+  int partial;      // the last record did not end a line
+  uint64 dropped;   // records lost because the ring was full
+};
+
+static struct kmsgcpu kmsgs[NCPU];
+
+static int draining;  // a CPU is in kmsgdrain()
+
+// serializes readers of the device, and protects rdk,
+// rdi and rdoff: how much of record rdk->rec[rdi] has
+// been read, if a reader's buffer ended inside it.
+static struct spinlock kmsglock;
+static struct kmsgcpu *rdk;
+static uint64 rdi;
+static int rdoff;
+
+// format x in decimal into buf, at least width digits,
+// padding with pad. returns the number of characters.
+static int
+fmtnum(char *buf, uint64 x, int width, char pad)
+{
+  char tmp[20];
+  int i = 0, n = 0;
+
+  do {
+    tmp[i++] = '0' + x % 10;
+  } while((x /= 10) != 0);
+  while(width-- > i)
+    buf[n++] = pad;
+  while(--i >= 0)
+    buf[n++] = tmp[i];
+  return n;
+}
+
+// Append a record of n bytes of s to k's ring, which
+// must have room.
+static void
+put(struct kmsgcpu *k, char *s, int n, int cont)
+{
+  struct kmsgrec *r;
+  uint64 w = k->w;
+
+  // readers must see w before any of the new record,
+  // so that they can tell if they raced with it.
+  __sync_synchronize();
+
+  r = &k->rec[w % NKMSG];
+  r->time = r_time();
+  r->cont = cont;
+  r->len = n;
+  memmove(r->text, s, n);
+  k->partial = (n > 0 && s[n-1] != '\n');
+
+  __atomic_store_n(&k->w, w + 1, __ATOMIC_RELEASE);
+}
+
+// Log n bytes of s, at most KMSGTEXT, as one record.
+// If records were dropped because the ring was full,
+// first log a record saying how many.
+// Interrupts must be disabled, so that the CPU's ring
+// has one writer.
+void
+kmsglog(char *s, int n)
+{
+  struct kmsgcpu *k = &kmsgs[cpuid()];
+  uint64 used = k->w - __atomic_load_n(&k->sent, __ATOMIC_ACQUIRE);
+  char note[48];
+  int m = 0;
+
+  if(used + (k->dropped > 0) >= NKMSG){
+    k->dropped++;
+    return;
+  }
+  if(k->dropped > 0){
+    if(k->partial)
+      note[m++] = '\n';
+    memmove(note+m, "kmsg: ", 6);
+    m += 6;
+    m += fmtnum(note+m, k->dropped, 1, ' ');
+    memmove(note+m, " records dropped\n", 17);
+    m += 17;
+    put(k, note, m, 0);
+    k->dropped = 0;
+  }
+  put(k, s, n, k->partial);
+}
+
+// the CPU whose oldest record in [*next, w) was logged
+// first, or 0 if there are none.
+static struct kmsgcpu*
+oldest(int reader)
+{
+  struct kmsgcpu *k, *best = 0;
+  uint64 i, w, besttime = 0;
+
+  for(k = kmsgs; k < &kmsgs[NCPU]; k++){
+    w = __atomic_load_n(&k->w, __ATOMIC_ACQUIRE);
+    if(reader){
+      if(w > NKMSG && k->rd < w - NKMSG + 1)
+        k->rd = w - NKMSG + 1;
+      i = k->rd;
+    } else {
+      i = k->sent;
+    }
+    if(i >= w)
+      continue;
+    if(best == 0 || k->rec[i % NKMSG].time < besttime){
+      best = k;
+      besttime = k->rec[i % NKMSG].time;
+    }
+  }
+  return best;
+}
+
+// Send logged records to the UART, oldest first, for as
+// long as there is room in its transmit buffer. Never
+// waits: if another CPU is already draining, it returns,
+// and uartintr() calls again when there is more room.
+void
+kmsgdrain(void)
+{
+  struct kmsgcpu *k;
+  struct kmsgrec *r;
+  int m;
+
+  while(__sync_lock_test_and_set(&draining, 1) == 0){
+    while((k = oldest(0)) != 0){
+      r = &k->rec[k->sent % NKMSG];
+      m = uarttrywrite(r->text + k->sentoff, r->len - k->sentoff);
+      k->sentoff += m;
+      if(k->sentoff < r->len)
+        break;
+      k->sentoff = 0;
+      __atomic_store_n(&k->sent, k->sent + 1, __ATOMIC_RELEASE);
+    }
+    __sync_lock_release(&draining);
+
+    // a record logged just before the release might
+    // have been missed by this CPU and by its logger.
+    if(k != 0 || oldest(0) == 0)
+      break;
+  }
+}
+
+// Send everything still unsent to the UART synchronously,
+// for panic(). Waits a while for a CPU in kmsgdrain() to
+// finish, so as not to send its records again, but not
+// forever: it may be this CPU, or stuck.
+void
+kmsgflushsync(void)
+{
+  struct kmsgcpu *k;
+  struct kmsgrec *r;
+  int i, got;
+
+  got = 0;
+  for(i = 0; i < 10000000 && !got; i++)
+    got = __sync_lock_test_and_set(&draining, 1) == 0;
+
+  while((k = oldest(0)) != 0){
+    r = &k->rec[k->sent % NKMSG];
+    for(; k->sentoff < r->len; k->sentoff++)
+      uartputc_sync(r->text[k->sentoff]);
+    k->sentoff = 0;
+    __atomic_store_n(&k->sent, k->sent + 1, __ATOMIC_RELEASE);
+  }
+
+  if(got)
+    __sync_lock_release(&draining);
+}
+
+//
+// user read()s from the KMSG device go here. returns
+// records that no reader has had yet, each line led by
+// its time in seconds, or 0 once there are none. a record
+// that doesn't fit is split, and the rest returned next.
+//
+int
+kmsgread(int user_dst, uint64 dst, int n)
+{
+  struct kmsgcpu *k;
+  struct kmsgrec r;
+  char line[KMSGTEXT+32];
+  uint64 i, us;
+  int m, off, tot = 0;
+
+  acquire(&kmsglock);
+  while((k = oldest(1)) != 0){
+    i = k->rd;
+    r = k->rec[i % NKMSG];
+    __sync_synchronize();
+    if(i + NKMSG <= __atomic_load_n(&k->w, __ATOMIC_ACQUIRE)){
+      // overwritten while being copied.
+      k->rd = i + 1;
+      continue;
+    }
+
+    m = 0;
+    if(!r.cont){
+      us = r.time / 10;  // time ticks at 10 MHz
+      line[m++] = '[';
+      m += fmtnum(line+m, us / 1000000, 5, ' ');
+      line[m++] = '.';
+      m += fmtnum(line+m, us % 1000000, 6, '0');
+      line[m++] = ']';
+      line[m++] = ' ';
+    }
+    memmove(line+m, r.text, r.len);
+    m += r.len;
+
+    off = (k == rdk && i == rdi) ? rdoff : 0;
+    m -= off;
+    if(m > n - tot){
+      if(tot > 0)
+        break;
+      // the rest of the record next time.
+      if(either_copyout(user_dst, dst, line + off, n) == -1)
+        break;
+      rdk = k;
+      rdi = i;
+      rdoff = off + n;
+      tot = n;
+      break;
+    }
+    if(either_copyout(user_dst, dst + tot, line + off, m) == -1)
+      break;
+    tot += m;
+    k->rd = i + 1;
+    rdk = 0;
+  }
+  release(&kmsglock);
+
+  return tot;
+}
+
+void
+kmsginit(void)
+{
+  initlock(&kmsglock, "kmsg");
+
+  devsw[KMSG].read = kmsgread;
+  devsw[KMSG].write = 0;
+}
@@ -13,6 +13,7 @@ main()
   if(cpuid() == 0){
     consoleinit();
     printfinit();
+    kmsginit();      // kernel log device
     printf("\n");
     printf("xv6 kernel is booting\n");
     printf("\n");
@@ -21,6 +22,8 @@ main()
     kvminithart();   // turn on paging
     procinit();      // process table
     trapinit();      // trap vectors
+    profinit();      // sampling profiler
+    traceinit();     // system call tracing
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
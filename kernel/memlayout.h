@@ -45,6 +45,8 @@
 
 // map kernel stacks beneath the trampoline,
 // each surrounded by invalid guard pages.
+// there are NPROC stack slots; a slot is only
+// mapped while a process is using it.
 #define KSTACK(p) (TRAMPOLINE - ((p)+1)* 2*PGSIZE)
 
 // User memory layout.
@@ -54,6 +56,12 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   USHARED (ushared, the same page in every process)
+//   USYSCALL (p->usyscall)
+//   USERRING (p->ring, if the process has called ringsetup())
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USERRING (TRAPFRAME - PGSIZE)
+#define USYSCALL (USERRING - PGSIZE)
+#define USHARED (USYSCALL - PGSIZE)
@@ -1,13 +1,16 @@
 #ifdef LAB_FS
 #define NPROC        10  // maximum number of processes
 #else
-#define NPROC        64  // maximum number of processes (speedsup bigfile)
+#define NPROC      2048  // maximum number of processes
 #endif
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
+#define NVMA         16  // memory-mapped regions per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
+#define KMSGTEXT    112  // bytes of text per kernel log record
+#define PROFINTERVAL 10000 // r_time() units between profiler samples (1 ms)
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
@@ -0,0 +1,9 @@
+// Hardware counter totals for a process, as returned by perf().
+// Counts include time spent in the kernel on the process's
+// behalf, but not in the scheduler or other processes.
+struct perfcount {
+  uint64 cycles;        // cycle counter while running
+  uint64 instret;       // instructions retired while running
+  uint64 ccycles;       // the same, summed over children
+  uint64 cinstret;      //   that have been waited for
+};
@@ -73,13 +73,27 @@ pipeclose(struct pipe *pi, int writable)
     release(&pi->lock);
 }
 
+// Write n bytes from addr, a user virtual address
+// if user_src is set, else a kernel address.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipewrite(struct pipe *pi, int user_src, uint64 addr, int n)
 {
-  int i = 0;
+  int i = 0, m;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
+
+  // a write of at most PIPESIZE bytes goes in all at once,
+  // so that it is not interleaved with other writers' data.
+  while(n <= PIPESIZE && pi->nwrite + n > pi->nread + PIPESIZE){
+    if(pi->readopen == 0 || killed(pr)){
+      release(&pi->lock);
+      return -1;
+    }
+    wakeup(&pi->nread);
+    sleep(&pi->nwrite, &pi->lock);
+  }
+
   while(i < n){
     if(pi->readopen == 0 || killed(pr)){
       release(&pi->lock);
@@ -89,11 +103,16 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+      // as much as fits before the buffer wraps.
+      m = PIPESIZE - pi->nwrite % PIPESIZE;
+      if(m > pi->nread + PIPESIZE - pi->nwrite)
+        m = pi->nread + PIPESIZE - pi->nwrite;
+      if(m > n - i)
+        m = n - i;
+      if(either_copyin(pi->data + pi->nwrite % PIPESIZE, user_src, addr + i, m) == -1)
         break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      pi->nwrite += m;
+      i += m;
     }
   }
   wakeup(&pi->nread);
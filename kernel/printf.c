@@ -1,6 +1,11 @@
 //
 // formatted console output -- printf, panic.
 //
+// printf() formats into a buffer on the stack and logs it
+// with kmsglog() (see kmsg.c), which sends it to the UART
+// in the background. once the kernel panics, output goes
+// straight to the UART instead.
+//
 
 #include <stdarg.h>
 
@@ -17,16 +22,34 @@
 
 volatile int panicked = 0;
 
-// lock to avoid interleaving concurrent printf's.
 static struct {
-  struct spinlock lock;
-  int locking;
+  int sync;     // write straight to the UART
 } pr;
 
+struct pbuf {
+  char buf[KMSGTEXT];
+  int n;
+};
+
+// add c to the output, logging the buffer when it fills.
+static void
+pputc(struct pbuf *pb, int c)
+{
+  if(pr.sync){
+    consputc(c);
+    return;
+  }
+  if(pb->n == KMSGTEXT){
+    kmsglog(pb->buf, pb->n);
+    pb->n = 0;
+  }
+  pb->buf[pb->n++] = c;
+}
+
 static char digits[] = "0123456789abcdef";
 
 static void
-printint(long long xx, int base, int sign)
+printint(struct pbuf *pb, long long xx, int base, int sign)
 {
   char buf[16];
   int i;
@@ -46,17 +69,17 @@ printint(long long xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    pputc(pb, buf[i]);
 }
 
 static void
-printptr(uint64 x)
+printptr(struct pbuf *pb, uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  pputc(pb, '0');
+  pputc(pb, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    pputc(pb, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the console.
@@ -64,17 +87,20 @@ int
 printf(char *fmt, ...)
 {
   va_list ap;
-  int i, cx, c0, c1, c2, locking;
+  int i, cx, c0, c1, c2;
   char *s;
+  struct pbuf pb;
 
-  locking = pr.locking;
-  if(locking)
-    acquire(&pr.lock);
+  pb.n = 0;
+
+  // stay on this CPU, and keep its interrupt handlers
+  // from logging until this message is done.
+  push_off();
 
   va_start(ap, fmt);
   for(i = 0; (cx = fmt[i] & 0xff) != 0; i++){
     if(cx != '%'){
-      consputc(cx);
+      pputc(&pb, cx);
       continue;
     }
     i++;
@@ -83,78 +109,83 @@ printf(char *fmt, ...)
     if(c0) c1 = fmt[i+1] & 0xff;
     if(c1) c2 = fmt[i+2] & 0xff;
     if(c0 == 'd'){
-      printint(va_arg(ap, int), 10, 1);
+      printint(&pb, va_arg(ap, int), 10, 1);
     } else if(c0 == 'l' && c1 == 'd'){
-      printint(va_arg(ap, uint64), 10, 1);
+      printint(&pb, va_arg(ap, uint64), 10, 1);
       i += 1;
     } else if(c0 == 'l' && c1 == 'l' && c2 == 'd'){
-      printint(va_arg(ap, uint64), 10, 1);
+      printint(&pb, va_arg(ap, uint64), 10, 1);
       i += 2;
     } else if(c0 == 'u'){
-      printint(va_arg(ap, int), 10, 0);
+      printint(&pb, va_arg(ap, int), 10, 0);
     } else if(c0 == 'l' && c1 == 'u'){
-      printint(va_arg(ap, uint64), 10, 0);
+      printint(&pb, va_arg(ap, uint64), 10, 0);
       i += 1;
     } else if(c0 == 'l' && c1 == 'l' && c2 == 'u'){
-      printint(va_arg(ap, uint64), 10, 0);
+      printint(&pb, va_arg(ap, uint64), 10, 0);
       i += 2;
     } else if(c0 == 'x'){
-      printint(va_arg(ap, int), 16, 0);
+      printint(&pb, va_arg(ap, int), 16, 0);
     } else if(c0 == 'l' && c1 == 'x'){
-      printint(va_arg(ap, uint64), 16, 0);
+      printint(&pb, va_arg(ap, uint64), 16, 0);
       i += 1;
     } else if(c0 == 'l' && c1 == 'l' && c2 == 'x'){
-      printint(va_arg(ap, uint64), 16, 0);
+      printint(&pb, va_arg(ap, uint64), 16, 0);
       i += 2;
     } else if(c0 == 'p'){
-      printptr(va_arg(ap, uint64));
+      printptr(&pb, va_arg(ap, uint64));
     } else if(c0 == 's'){
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        pputc(&pb, *s);
     } else if(c0 == '%'){
-      consputc('%');
+      pputc(&pb, '%');
     } else if(c0 == 0){
       break;
     } else {
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c0);
+      pputc(&pb, '%');
+      pputc(&pb, c0);
     }
 
 #if 0
     switch(c){
     case 'd':
-      printint(va_arg(ap, int), 10, 1);
+      printint(&pb, va_arg(ap, int), 10, 1);
       break;
     case 'x':
-      printint(va_arg(ap, int), 16, 1);
+      printint(&pb, va_arg(ap, int), 16, 1);
       break;
     case 'p':
-      printptr(va_arg(ap, uint64));
+      printptr(&pb, va_arg(ap, uint64));
       break;
     case 's':
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        pputc(&pb, *s);
       break;
     case '%':
-      consputc('%');
+      pputc(&pb, '%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      pputc(&pb, '%');
+      pputc(&pb, c);
       break;
     }
 #endif
   }
   va_end(ap);
 
-  if(locking)
-    release(&pr.lock);
+  if(pb.n > 0)
+    kmsglog(pb.buf, pb.n);
+  pop_off();
+
+  // after a panic, this CPU may hold the uart's lock.
+  if(!pr.sync)
+    kmsgdrain();
 
   return 0;
 }
@@ -162,7 +193,12 @@ printf(char *fmt, ...)
 void
 panic(char *s)
 {
-  pr.locking = 0;
+  // print synchronously, after whatever was logged
+  // but not yet sent.
+  push_off();
+  kmsgflushsync();
+  pr.sync = 1;
+  pop_off();
   printf("panic: ");
   printf("%s\n", s);
   panicked = 1; // freeze uart output from other CPUs
@@ -173,6 +209,5 @@ panic(char *s)
 void
 printfinit(void)
 {
-  initlock(&pr.lock, "pr");
-  pr.locking = 1;
+  pr.sync = 0;
 }
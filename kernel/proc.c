@@ -4,58 +4,135 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "slab.h"
+#include "syscall.h"
+#include "trace.h"
+#include "ring.h"
+#include "usyscall.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// every allocated proc is on ptable's list. procs come from
+// proccache as needed, and each owns one of NPROC kernel stack
+// slots (see KSTACK in memlayout.h), mapped only while it exists.
+// ptable.lock must be acquired before any p->lock.
+struct {
+  struct spinlock lock;
+  struct proc head;                  // list of procs via next/prev
+  uint64 kstackmap[(NPROC+63)/64];   // kernel stack slots in use
+} ptable;
+
+// RUNNABLE procs, via qnext/qprev, in the order the
+// scheduler will run them, so that it need not look at
+// the others. runq.lock is acquired after any p->lock.
+struct {
+  struct spinlock lock;
+  struct proc *head;
+  struct proc *tail;
+} runq;
+
+// SLEEPING procs, via qnext/qprev, hashed by p->chan, so that
+// wakeup() need only look at those that might be sleeping on
+// its chan, and wakeups on different chans rarely share a lock.
+// a sleep queue's lock is acquired before p->lock.
+#define NSLEEPQ 64
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;
+} sleepq[NSLEEPQ];
+
+#define SLEEPQ(chan) (&sleepq[((uint64)(chan) >> 3) % NSLEEPQ])
+
+static struct kcache proccache;
 
 struct proc *initproc;
 
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// live processes hashed by pid, so that kill() need
+// not scan the whole table. protected by pid_lock,
+// which must be acquired before any p->lock.
+#define NPIDHASH 64
+#define PIDHASH(pid) ((uint)(pid) % NPIDHASH)
+struct proc *pidhash[NPIDHASH];
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void putproc(struct proc *p);
+static void addchild(struct proc *p, struct proc *np);
+static void setrunnable(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
+// ASIDs tag TLB entries with an address space, so that
+// switching satp between page tables need not flush the TLB.
+// the kernel page table uses ASID 0. a process that needs an
+// ASID takes the next unused one; rather than flushing stale
+// entries after changing its page table, it takes a new one.
+// when the ASIDs run out, the generation advances, every
+// process must take a new ASID, and each hart flushes its
+// whole TLB once before running anything in the new generation.
+struct {
+  struct spinlock lock;
+  uint64 gen;   // current generation
+  uint64 next;  // next unused ASID in gen
+} asids;
+
+#define ASIDGEN(asid) ((asid) >> 16)
+#define ASIDNUM(asid) ((asid) & 0xFFFF)
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
-// must be acquired before any p->lock.
+// must be acquired before pid_lock and any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl)
-{
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-  }
-}
-
 // initialize the proc table.
 void
 procinit(void)
 {
-  struct proc *p;
-  
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->state = UNUSED;
-      p->kstack = KSTACK((int) (p - proc));
+  initlock(&ptable.lock, "ptable");
+  initlock(&runq.lock, "runq");
+  for(int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepq[i].lock, "sleepq");
+  initlock(&asids.lock, "asids");
+  asids.gen = 1;
+  asids.next = 1;
+  ptable.head.next = &ptable.head;
+  ptable.head.prev = &ptable.head;
+  kcacheinit(&proccache, "proc", sizeof(struct proc));
+}
+
+// Claim a free kernel stack slot, or return -1 if
+// NPROC processes already exist.
+// ptable.lock must be held.
+static int
+allocslot(void)
+{
+  int i, slot;
+
+  for(i = 0; i < NELEM(ptable.kstackmap); i++){
+    if(ptable.kstackmap[i] == ~0UL)
+      continue;
+    for(slot = i*64; slot < i*64+64 && slot < NPROC; slot++){
+      if((ptable.kstackmap[i] & (1UL << (slot%64))) == 0){
+        ptable.kstackmap[i] |= 1UL << (slot%64);
+        return slot;
+      }
+    }
   }
+  return -1;
+}
+
+// ptable.lock must be held.
+static void
+freeslot(int slot)
+{
+  ptable.kstackmap[slot/64] &= ~(1UL << (slot%64));
 }
 
 // Must be called with interrupts disabled,
@@ -89,54 +166,101 @@ myproc(void)
   return p;
 }
 
-int
-allocpid()
+// Give p a new pid and enter it in pidhash.
+// p->lock must not be held.
+static void
+allocpid(struct proc *p)
 {
-  int pid;
-  
+  struct proc **bucket;
+
   acquire(&pid_lock);
-  pid = nextpid;
+  p->pid = nextpid;
   nextpid = nextpid + 1;
+  bucket = &pidhash[PIDHASH(p->pid)];
+  p->hashnext = *bucket;
+  *bucket = p;
   release(&pid_lock);
+}
 
-  return pid;
+// Remove p from pidhash and clear its pid.
+// p->lock must not be held.
+static void
+freepid(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pid_lock);
+  for(pp = &pidhash[PIDHASH(p->pid)]; *pp; pp = &(*pp)->hashnext){
+    if(*pp == p){
+      *pp = p->hashnext;
+      break;
+    }
+  }
+  p->hashnext = 0;
+  p->pid = 0;
+  release(&pid_lock);
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
+// Allocate a new proc and map a kernel stack for it.
+// If successful, initialize state required to run in the kernel,
 // and return with p->lock held.
-// If there are no free procs, or a memory allocation fails, return 0.
+// If NPROC procs already exist, or a memory allocation fails, return 0.
 static struct proc*
 allocproc(void)
 {
   struct proc *p;
+  int slot;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
+  if((p = kcachealloc(&proccache)) == 0)
+    return 0;
+  initlock(&p->lock, "proc");
+
+  acquire(&ptable.lock);
+  if((slot = allocslot()) < 0 || kvmmapstack(KSTACK(slot)) < 0){
+    if(slot >= 0)
+      freeslot(slot);
+    release(&ptable.lock);
+    kcachefree(&proccache, p);
+    return 0;
   }
-  return 0;
+  p->kstack = KSTACK(slot);
+
+  // at the end of the list, for procdump().
+  p->next = &ptable.head;
+  p->prev = ptable.head.prev;
+  ptable.head.prev->next = p;
+  ptable.head.prev = p;
+  release(&ptable.lock);
 
-found:
-  p->pid = allocpid();
+  allocpid(p);
+
+  acquire(&p->lock);
   p->state = USED;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
     freeproc(p);
     release(&p->lock);
+    putproc(p);
     return 0;
   }
 
+  // Allocate the page that ulib reads the pid from.
+  if((p->usyscall = (struct usyscall *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    putproc(p);
+    return 0;
+  }
+  memset(p->usyscall, 0, PGSIZE);
+  p->usyscall->pid = p->pid;
+
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
     freeproc(p);
     release(&p->lock);
+    putproc(p);
     return 0;
   }
 
@@ -158,19 +282,56 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
+  if(p->vstate)
+    kfree(p->vstate);
+  p->vstate = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  p->ring = 0;
   p->sz = 0;
-  p->pid = 0;
   p->parent = 0;
+  p->child = 0;
+  p->nextsib = 0;
+  p->prevsib = 0;
   p->name[0] = 0;
+  p->cycles = p->instret = 0;
+  p->ccycles = p->cinstret = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
   p->state = UNUSED;
 }
 
+// Give back p, which freeproc() has emptied, along
+// with its pid and kernel stack.
+// p->lock must not be held.
+static void
+putproc(struct proc *p)
+{
+  // after this, kill() can no longer find p.
+  freepid(p);
+
+  // wait out a kill() that found p before freepid().
+  acquire(&p->lock);
+  release(&p->lock);
+
+  // scheduler() and wakeup() only find procs on the run
+  // and sleep queues, which p, a zombie, is on neither of,
+  // and procdump() holds ptable.lock.
+  acquire(&ptable.lock);
+  p->next->prev = p->prev;
+  p->prev->next = p->next;
+  kvmunmapstack(p->kstack);
+  freeslot((TRAMPOLINE - p->kstack) / (2*PGSIZE) - 1);
+  release(&ptable.lock);
+
+  kcachefree(&proccache, p);
+}
+
 // Create a user page table for a given process, with no user memory,
 // but with trampoline and trapframe pages.
 pagetable_t
@@ -202,9 +363,94 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the pages that ulib reads for getpid(), uptime()
+  // and clock_gettime(), read-only.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+  if(mappages(pagetable, USHARED, PGSIZE,
+              (uint64)ushared, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, USYSCALL, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
+// Give p a zeroed ring page, mapped at USERRING.
+// The caller must then invalidate p->asid if p
+// has been running with its page table.
+// Returns 0, or -1 if out of memory.
+int
+proc_ring(struct proc *p)
+{
+  struct ring *r;
+
+  if(p->ring)
+    return 0;
+  if((r = (struct ring*)kalloc()) == 0)
+    return -1;
+  memset(r, 0, PGSIZE);
+  if(mappages(p->pagetable, USERRING, PGSIZE,
+              (uint64)r, PTE_R | PTE_W | PTE_U) < 0){
+    kfree(r);
+    return -1;
+  }
+  p->ring = r;
+  return 0;
+}
+
+// Return the satp value for running p in user space,
+// giving p a fresh ASID if it has none in the current
+// generation, and flushing what this hart's TLB may
+// still hold from older generations.
+// Called with interrupts disabled, on the way to user space.
+uint64
+proc_satp(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  uint64 gen;
+  int fresh = 0;
+
+  if(asidmax == 0){
+    // no ASIDs: trampoline.S flushes on every switch.
+    return MAKE_SATP(p->pagetable);
+  }
+
+  gen = asids.gen;
+  if(ASIDGEN(p->asid) != gen){
+    acquire(&asids.lock);
+    if(asids.next > asidmax){
+      // out of ASIDs: start a new generation.
+      asids.gen++;
+      asids.next = 1;
+    }
+    gen = asids.gen;
+    p->asid = (gen << 16) | asids.next++;
+    release(&asids.lock);
+    fresh = 1;
+  }
+
+  if(c->asidgen != gen){
+    sfence_vma();
+    c->asidgen = gen;
+  } else if(fresh){
+    // no TLB holds entries for a fresh ASID, but the
+    // page table may have changed: order those writes
+    // before the hardware walks it.
+    sfence_vma_asid(ASIDNUM(p->asid));
+  }
+
+  return MAKE_SATP_ASID(p->pagetable, ASIDNUM(p->asid));
+}
+
 // Free a process's page table, and free the
 // physical memory it refers to.
 void
@@ -212,6 +458,10 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
+  uvmunmap(pagetable, USHARED, 1, 0);
+  if(walkaddr(pagetable, USERRING))
+    uvmunmap(pagetable, USERRING, 1, 1);
   uvmfree(pagetable, sz);
 }
 
@@ -249,7 +499,7 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
@@ -264,13 +514,20 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    if(vmafind(p, sz, sz + n) != 0 ||
+       (sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
       return -1;
     }
   } else if(n < 0){
+    // uvmdealloc() can't fail, so split a superpage
+    // that the new end cuts first.
+    if(sz + n < sz && uvmsplit(p->pagetable, PGROUNDUP(sz + n)) < 0)
+      return -1;
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
   p->sz = sz;
+  // the TLB may hold stale entries under the old ASID.
+  p->asid = 0;
   return 0;
 }
 
@@ -292,10 +549,30 @@ fork(void)
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
     freeproc(np);
     release(&np->lock);
+    putproc(np);
     return -1;
   }
   np->sz = p->sz;
 
+  // the ring is ordinary memory as far as the
+  // process is concerned, so copy it too.
+  if(p->ring){
+    if(proc_ring(np) < 0){
+      freeproc(np);
+      release(&np->lock);
+      putproc(np);
+      return -1;
+    }
+    memmove(np->ring, p->ring, sizeof(struct ring));
+  }
+
+  if(vmacopy(np, p) < 0){
+    freeproc(np);
+    release(&np->lock);
+    putproc(np);
+    return -1;
+  }
+
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
 
@@ -310,34 +587,71 @@ fork(void)
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  np->tracemask = p->tracemask;
+  np->tracer = p->tracer;
+
   pid = np->pid;
 
   release(&np->lock);
 
+  if(np->tracer)
+    tracecount(np->tracer, 1);
+
   acquire(&wait_lock);
-  np->parent = p;
+  addchild(p, np);
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
 }
 
+// Make np a child of p, at the head of p's list of children.
+// Caller must hold wait_lock.
+static void
+addchild(struct proc *p, struct proc *np)
+{
+  np->parent = p;
+  np->prevsib = 0;
+  np->nextsib = p->child;
+  if(p->child)
+    p->child->prevsib = np;
+  p->child = np;
+}
+
+// Unlink p from its parent's list of children.
+// Caller must hold wait_lock.
+static void
+delchild(struct proc *p)
+{
+  if(p->prevsib)
+    p->prevsib->nextsib = p->nextsib;
+  else
+    p->parent->child = p->nextsib;
+  if(p->nextsib)
+    p->nextsib->prevsib = p->prevsib;
+  p->parent = 0;
+  p->nextsib = 0;
+  p->prevsib = 0;
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
 reparent(struct proc *p)
 {
-  struct proc *pp;
+  struct proc *pp, *next;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->child == 0)
+    return;
+  for(pp = p->child; pp; pp = next){
+    next = pp->nextsib;
+    addchild(initproc, pp);
   }
+  p->child = 0;
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -351,6 +665,22 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // exit never returns to syscall(), so trace it here,
+  // however the process came to exit.
+  if(p->tracemask & (1L << SYS_exit)){
+    struct tracerec t;
+    memset(&t, 0, sizeof(t));
+    t.time = r_time();
+    t.args[0] = status;
+    t.pid = p->pid;
+    t.tracer = p->tracer;
+    t.num = SYS_exit;
+    tracelog(&t);
+  }
+
+  // Write back and unmap mapped files.
+  vmafree(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -367,6 +697,11 @@ exit(int status)
 
   acquire(&wait_lock);
 
+  // the tracer learns of the exit from its count,
+  // since the exit record may have been dropped.
+  if(p->tracer)
+    tracecount(p->tracer, -1);
+
   // Give any children to init.
   reparent(p);
 
@@ -394,33 +729,39 @@ wait(uint64 addr)
   int havekids, pid;
   struct proc *p = myproc();
 
+  // the status is copied out holding wait_lock and pp->lock.
+  if(addr != 0 && vmaprefault(p, addr, sizeof(int), 1) < 0)
+    return -1;
+
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through our children looking for exited ones.
     havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
+    for(pp = p->child; pp; pp = pp->nextsib){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+
+      havekids = 1;
+      if(pp->state == ZOMBIE){
+        // Found one.
+        pid = pp->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                                sizeof(pp->xstate)) < 0) {
           release(&pp->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        p->ccycles += pp->cycles + pp->ccycles;
+        p->cinstret += pp->instret + pp->cinstret;
+        delchild(pp);
+        freeproc(pp);
         release(&pp->lock);
+        release(&wait_lock);
+        putproc(pp);
+        return pid;
       }
+      release(&pp->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -454,29 +795,47 @@ scheduler(void)
     // processes are waiting.
     intr_on();
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
-      }
-      release(&p->lock);
+    // take the first runnable process; it goes to the
+    // back of the queue when it next becomes runnable.
+    acquire(&runq.lock);
+    if((p = runq.head) != 0){
+      runq.head = p->qnext;
+      if(runq.head)
+        runq.head->qprev = 0;
+      else
+        runq.tail = 0;
     }
-    if(found == 0) {
+    release(&runq.lock);
+    if(p == 0){
       // nothing to run; stop running on this core until an interrupt.
       intr_on();
       asm volatile("wfi");
+      continue;
     }
+
+    // off the queue, p stays RUNNABLE until this CPU runs
+    // it, though if it has just given up another CPU, this
+    // waits here until that CPU's scheduler releases p->lock.
+    acquire(&p->lock);
+    if(p->state != RUNNABLE)
+      panic("scheduler: not runnable");
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    p->state = RUNNING;
+    c->proc = p;
+    kvmsync();  // make sure p's kernel stack is mapped in our TLB
+    c->cycles0 = r_cycle();
+    c->instret0 = r_instret();
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    p->cycles += r_cycle() - c->cycles0;
+    p->instret += r_instret() - c->instret0;
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
@@ -513,11 +872,43 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
 
+// Make p RUNNABLE, at the back of the run queue.
+// Caller must hold p->lock, and p must not be on a
+// sleep queue.
+static void
+setrunnable(struct proc *p)
+{
+  p->state = RUNNABLE;
+  acquire(&runq.lock);
+  p->qnext = 0;
+  p->qprev = runq.tail;
+  if(runq.tail)
+    runq.tail->qnext = p;
+  else
+    runq.head = p;
+  runq.tail = p;
+  release(&runq.lock);
+}
+
+// Take the SLEEPING p off sleep queue sq and make it
+// RUNNABLE. Caller must hold sq->lock and p->lock.
+static void
+unsleep(struct sleepq *sq, struct proc *p)
+{
+  if(p->qprev)
+    p->qprev->qnext = p->qnext;
+  else
+    sq->head = p->qnext;
+  if(p->qnext)
+    p->qnext->qprev = p->qprev;
+  setrunnable(p);
+}
+
 // A fork child's very first scheduling by scheduler()
 // will swtch to forkret.
 void
@@ -548,20 +939,28 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *sq = SLEEPQ(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // Once we hold chan's sleep queue lock,
+  // we can be guaranteed that we won't miss
+  // any wakeup (wakeup locks it),
   // so it's okay to release lk.
 
+  acquire(&sq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->qprev = 0;
+  p->qnext = sq->head;
+  if(sq->head)
+    sq->head->qprev = p;
+  sq->head = p;
+  release(&sq->lock);
 
   sched();
 
@@ -578,17 +977,18 @@ sleep(void *chan, struct spinlock *lk)
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  struct sleepq *sq = SLEEPQ(chan);
+  struct proc *p, *next;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-    }
+  acquire(&sq->lock);
+  for(p = sq->head; p; p = next){
+    next = p->qnext;
+    acquire(&p->lock);
+    if(p->chan == chan)
+      unsleep(sq, p);
+    release(&p->lock);
   }
+  release(&sq->lock);
 }
 
 // Kill the process with the given pid.
@@ -598,21 +998,99 @@ int
 kill(int pid)
 {
   struct proc *p;
+  struct sleepq *sq;
+  void *chan = 0;
+
+  // hold pid_lock throughout, so that p cannot be
+  // freed while we use it (see putproc()).
+  acquire(&pid_lock);
+  for(p = pidhash[PIDHASH(pid)]; p; p = p->hashnext)
+    if(p->pid == pid)
+      break;
+  if(p == 0){
+    release(&pid_lock);
+    return -1;
+  }
+  acquire(&p->lock);
+  p->killed = 1;
+  if(p->state == SLEEPING)
+    chan = p->chan;
+  release(&p->lock);
 
-  for(p = proc; p < &proc[NPROC]; p++){
+  if(chan){
+    // Wake process from sleep(), taking its sleep
+    // queue's lock first, unless it woke meanwhile.
+    sq = SLEEPQ(chan);
+    acquire(&sq->lock);
     acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
+    if(p->state == SLEEPING && p->chan == chan)
+      unsleep(sq, p);
     release(&p->lock);
+    release(&sq->lock);
   }
-  return -1;
+  release(&pid_lock);
+  return 0;
+}
+
+// Add d to the count of live processes traced for the
+// process with pid tracer. Returns the new count, or -1
+// if there is no such process.
+int
+tracecount(int tracer, int d)
+{
+  struct proc *p;
+  int n = -1;
+
+  acquire(&pid_lock);
+  for(p = pidhash[PIDHASH(tracer)]; p; p = p->hashnext){
+    if(p->pid == tracer){
+      p->ntraced += d;
+      n = p->ntraced;
+      break;
+    }
+  }
+  release(&pid_lock);
+  return n;
+}
+
+// Trace the system calls in mask, 1<<SYS_xxx, made by the
+// current process's child pid and by the children it forks
+// from then on, for the current process to read with
+// traceread(). mask 0 stops tracing the child.
+// Returns 0, or -1 if pid is not a live child.
+int
+traceattach(int pid, uint64 mask)
+{
+  struct proc *p = myproc(), *c;
+  int zombie;
+
+  // exit() decrements the tracer's count holding wait_lock,
+  // so holding it here, c either has done so already and is
+  // a zombie, or will see the new tracer.
+  acquire(&wait_lock);
+  for(c = p->child; c; c = c->nextsib)
+    if(c->pid == pid)
+      break;
+  if(c == 0){
+    release(&wait_lock);
+    return -1;
+  }
+  acquire(&c->lock);
+  zombie = c->state == ZOMBIE;
+  release(&c->lock);
+  if(zombie){
+    release(&wait_lock);
+    return -1;
+  }
+
+  if(c->tracer)
+    tracecount(c->tracer, -1);
+  c->tracer = mask ? p->pid : 0;
+  if(c->tracer)
+    tracecount(c->tracer, 1);
+  c->tracemask = mask;
+  release(&wait_lock);
+  return 0;
 }
 
 void
@@ -666,7 +1144,9 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
 
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
-// No lock to avoid wedging a stuck machine further.
+// Takes only ptable.lock, which keeps procs from being
+// freed underneath us; no p->lock, to avoid wedging a
+// stuck machine further.
 void
 procdump(void)
 {
@@ -682,7 +1162,8 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  acquire(&ptable.lock);
+  for(p = ptable.head.next; p != &ptable.head; p = p->next){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -692,4 +1173,5 @@ procdump(void)
     printf("%d %s %s", p->pid, state, p->name);
     printf("\n");
   }
+  release(&ptable.lock);
 }
@@ -24,6 +24,10 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 asidgen;             // ASID generation the TLB was last flushed for.
+  uint64 nexttick;            // r_time() of the next clock tick.
+  uint64 cycles0;             // r_cycle() when proc was switched in.
+  uint64 instret0;            // r_instret() when proc was switched in.
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +85,16 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A file mapped by mmap(); see vma.c.
+struct vma {
+  uint64 start;                // First address, page-aligned
+  uint64 end;                  // Just past the last
+  int prot;                    // PROT_xxx from fcntl.h
+  int flags;                   // MAP_SHARED or MAP_PRIVATE
+  uint off;                    // File offset mapped at start
+  struct file *f;              // The file, or 0 if unused
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -92,16 +106,45 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *child;          // First child, others linked by nextsib
+  struct proc *nextsib;        // Next child of parent
+  struct proc *prevsib;        // Previous child of parent
+
+  // pid_lock must be held when using these:
+  struct proc *hashnext;       // Next proc in the same pidhash bucket
+  int ntraced;                 // Live procs whose tracer is p; see trace.c
+
+  // ptable.lock must be held when using these:
+  struct proc *next;           // Process list, in order of creation
+  struct proc *prev;
+
+  // the lock of the queue p is on must be held when using these:
+  struct proc *qnext;          // Run queue if RUNNABLE, sleep queue if SLEEPING
+  struct proc *qprev;
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
+  uint64 asid;                 // ASID generation and number, or 0 if none
   struct trapframe *trapframe; // data page for trampoline.S
+  struct ring *ring;           // Page mapped at USERRING, or 0; see ring.h
+  struct usyscall *usyscall;   // Page mapped read-only at USYSCALL
+  char *vstate;                // Saved vector registers, if p uses them
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vmas[NVMA];       // Memory-mapped files
   char name[16];               // Process name (debugging)
+  uint64 tracemask;            // System calls to trace, 1<<SYS_xxx; see trace.c
+  int tracer;                  // Pid that reads p's trace records
+
+  // p->lock must be held when using these, unless p is
+  // the current process; see perf.h.
+  uint64 cycles;
+  uint64 instret;
+  uint64 ccycles;
+  uint64 cinstret;
 };
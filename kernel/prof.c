@@ -0,0 +1,175 @@
+//
+// Sampling profiler. While it is on, each hart's timer
+// interrupts every PROFINTERVAL as well as at each clock
+// tick, and usertrap() and kerneltrap() record where the
+// hart was, with a few return addresses from the frame
+// pointer chain, in the hart's sample buffer.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+#define NPROFPAGE 32    // pages of samples per hart
+#define PERPAGE (PGSIZE / sizeof(struct profsample))
+
+struct profcpu {
+  struct spinlock lock;
+  char *pages[NPROFPAGE];
+  int n;                // samples taken
+  int rd;               // samples handed to profread()
+  int dropped;          // samples lost because the buffer was full
+};
+
+static struct profcpu profcpus[NCPU];
+
+// sampling is on; read by clockintr().
+int profon;
+
+void
+profinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&profcpus[i].lock, "prof");
+}
+
+static void
+proffree(void)
+{
+  struct profcpu *pc;
+
+  for(pc = profcpus; pc < &profcpus[NCPU]; pc++){
+    acquire(&pc->lock);
+    for(int i = 0; i < NPROFPAGE; i++){
+      if(pc->pages[i])
+        kfree(pc->pages[i]);
+      pc->pages[i] = 0;
+    }
+    pc->n = pc->rd = pc->dropped = 0;
+    release(&pc->lock);
+  }
+}
+
+// Turn sampling on, discarding any earlier samples,
+// or off, keeping them for profread().
+// Returns 0 on success, -1 if out of memory.
+int
+profctl(int on)
+{
+  struct profcpu *pc;
+  char *mem;
+
+  if(!on){
+    profon = 0;
+    return 0;
+  }
+
+  profon = 0;
+  proffree();
+  for(pc = profcpus; pc < &profcpus[NCPU]; pc++){
+    for(int i = 0; i < NPROFPAGE; i++){
+      if((mem = kalloc()) == 0){
+        proffree();
+        return -1;
+      }
+      acquire(&pc->lock);
+      pc->pages[i] = mem;
+      release(&pc->lock);
+    }
+  }
+  __sync_synchronize();
+  profon = 1;
+  return 0;
+}
+
+// Record a sample for this hart: user says whether it
+// was in user mode, at pc with frame pointer fp.
+// Called with interrupts off.
+void
+profsample(int user, uint64 pc, uint64 fp)
+{
+  struct profcpu *c = &profcpus[cpuid()];
+  struct proc *p = myproc();
+  struct profsample *s;
+  uint64 frame[2], top;
+  int i;
+
+  if(!profon)
+    return;
+
+  acquire(&c->lock);
+  if(c->n == NPROFPAGE * PERPAGE || c->pages[c->n / PERPAGE] == 0){
+    c->dropped++;
+    release(&c->lock);
+    return;
+  }
+  s = (struct profsample*)c->pages[c->n / PERPAGE] + c->n % PERPAGE;
+  memset(s, 0, sizeof(*s));
+  s->cpu = cpuid();
+  s->user = user;
+  if(p){
+    s->pid = p->pid;
+    safestrcpy(s->name, p->name, sizeof(s->name));
+  }
+  s->pc[0] = pc;
+
+  // follow the frame pointers: the return address is at
+  // fp-8 and the caller's frame pointer at fp-16.
+  top = PGROUNDUP(r_sp());
+  for(i = 1; i < PROFDEPTH && fp != 0; i++){
+    if(user){
+      if(copyin(p->pagetable, (char*)frame, fp - 16, sizeof(frame)) < 0)
+        break;
+    } else {
+      // kernel stacks are one page.
+      if(fp <= r_sp() || fp > top)
+        break;
+      frame[0] = *(uint64*)(fp - 16);
+      frame[1] = *(uint64*)(fp - 8);
+    }
+    s->pc[i] = frame[1];
+    if(frame[0] <= fp)
+      break;
+    fp = frame[0];
+  }
+  c->n++;
+  release(&c->lock);
+}
+
+// Copy up to n samples that profread() has not yet
+// returned to user address addr. Once all have been read
+// with sampling off, frees the buffers.
+// Returns the number of samples copied, or -1.
+int
+profread(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct profcpu *c;
+  struct profsample *s;
+  int tot = 0;
+
+  if(vmaprefault(p, addr, (uint64)n * sizeof(*s), 1) < 0)
+    return -1;
+  for(c = profcpus; c < &profcpus[NCPU] && tot < n; c++){
+    acquire(&c->lock);
+    while(c->rd < c->n && tot < n){
+      s = (struct profsample*)c->pages[c->rd / PERPAGE] + c->rd % PERPAGE;
+      if(copyout(p->pagetable, addr + tot*sizeof(*s), (char*)s, sizeof(*s)) < 0){
+        release(&c->lock);
+        return -1;
+      }
+      c->rd++;
+      tot++;
+    }
+    release(&c->lock);
+  }
+
+  if(tot == 0 && !profon)
+    proffree();
+  return tot;
+}
@@ -0,0 +1,10 @@
+// A sample taken by the profiler; see prof.c.
+#define PROFDEPTH 6
+
+struct profsample {
+  uint64 pc[PROFDEPTH];  // pc[0] where the hart was, then return addresses; 0 ends
+  int pid;               // 0 if the hart was idle
+  short cpu;
+  short user;            // 1 if the hart was in user mode
+  char name[16];         // process name
+};
@@ -0,0 +1,43 @@
+// A submission/completion ring shared between a process and
+// the kernel, so that a batch of file system calls costs one
+// trap; see ringsetup() and ring_enter() in sysfile.c.
+//
+// The process fills sq[sqtail % NRING] and advances sqtail;
+// ring_enter() runs entries from sqhead, advancing it, and
+// posts each result at cq[cqtail % NRING]. The process reads
+// completions from cqhead, advancing it. The indices run
+// freely and wrap; a queue holds at most NRING entries.
+
+#define NRING 64
+
+// operations
+#define RING_NOP    0
+#define RING_READ   1   // read(fd, addr, n)
+#define RING_WRITE  2   // write(fd, addr, n)
+#define RING_OPEN   3   // open(addr, n), where n is the mode
+#define RING_CLOSE  4   // close(fd)
+#define RING_FSTAT  5   // fstat(fd, addr)
+
+struct sqe {
+  int op;
+  int fd;
+  uint64 addr;      // user buffer, path, or struct stat
+  int n;            // byte count, or open mode
+  int flags;        // unused, must be 0
+  uint64 data;      // copied to the completion, for the caller
+};
+
+struct cqe {
+  uint64 data;      // from the submission
+  int res;          // what the system call would have returned
+  int pad;
+};
+
+struct ring {
+  uint sqhead;      // advanced by the kernel
+  uint sqtail;      // advanced by the process
+  uint cqhead;      // advanced by the process
+  uint cqtail;      // advanced by the kernel
+  struct sqe sq[NRING];
+  struct cqe cq[NRING];
+};
@@ -42,6 +42,10 @@ w_mepc(uint64 x)
 
 // Supervisor Status Register, sstatus
 
+#define SSTATUS_VS (3L << 9)   // Vector state: Off, Initial, Clean, Dirty
+#define SSTATUS_VS_INITIAL (1L << 9)
+#define SSTATUS_VS_CLEAN (2L << 9)
+#define SSTATUS_VS_DIRTY (3L << 9)
 #define SSTATUS_SPP (1L << 8)  // Previous mode, 1=Supervisor, 0=User
 #define SSTATUS_SPIE (1L << 5) // Supervisor Previous Interrupt Enable
 #define SSTATUS_UPIE (1L << 4) // User Previous Interrupt Enable
@@ -226,6 +230,13 @@ w_pmpaddr0(uint64 x)
 
 #define MAKE_SATP(pagetable) (SATP_SV39 | (((uint64)pagetable) >> 12))
 
+// the address-space identifier (ASID) field of satp, which
+// tags TLB entries. the kernel's page table uses ASID 0.
+#define SATP_ASID_SHIFT 44
+#define SATP_ASID_MASK (0xFFFFL << SATP_ASID_SHIFT)
+#define MAKE_SATP_ASID(pagetable, asid) \
+  (MAKE_SATP(pagetable) | ((uint64)(asid) << SATP_ASID_SHIFT))
+
 // supervisor address translation and protection;
 // holds the address of the page table.
 static inline void 
@@ -275,6 +286,27 @@ r_mcounteren()
   return x;
 }
 
+// Counter-Enable bits, the same in mcounteren and scounteren.
+#define COUNTEREN_CY (1L << 0) // cycle
+#define COUNTEREN_TM (1L << 1) // time
+#define COUNTEREN_IR (1L << 2) // instret
+
+// Supervisor-mode Counter-Enable
+
+static inline void 
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -284,6 +316,24 @@ r_time()
   return x;
 }
 
+// cycles executed by this hart.
+static inline uint64
+r_cycle()
+{
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r" (x) );
+  return x;
+}
+
+// instructions retired by this hart.
+static inline uint64
+r_instret()
+{
+  uint64 x;
+  asm volatile("csrr %0, instret" : "=r" (x) );
+  return x;
+}
+
 // enable device interrupts
 static inline void
 intr_on()
@@ -354,6 +404,14 @@ sfence_vma()
   asm volatile("sfence.vma zero, zero");
 }
 
+// flush just the TLB entries tagged with asid.
+static inline void
+sfence_vma_asid(uint64 asid)
+{
+  // an "r" operand is never x0, which would mean all ASIDs.
+  asm volatile("sfence.vma zero, %0" : : "r" (asid));
+}
+
 typedef uint64 pte_t;
 typedef uint64 *pagetable_t; // 512 PTEs
 
@@ -362,10 +420,8 @@ typedef uint64 *pagetable_t; // 512 PTEs
 #define PGSIZE 4096 // bytes per page
 #define PGSHIFT 12  // bits of offset within a page
 
-#ifdef LAB_PGTBL
-#define SUPERPGSIZE (2 * (1 << 20)) // bytes per page
+#define SUPERPGSIZE (2 * (1 << 20)) // bytes per superpage (a level-1 leaf)
 #define SUPERPGROUNDUP(sz)  (((sz)+SUPERPGSIZE-1) & ~(SUPERPGSIZE-1))
-#endif
 
 #define PGROUNDUP(sz)  (((sz)+PGSIZE-1) & ~(PGSIZE-1))
 #define PGROUNDDOWN(a) (((a)) & ~(PGSIZE-1))
@@ -375,12 +431,14 @@ typedef uint64 *pagetable_t; // 512 PTEs
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // user can access
+#define PTE_A (1L << 6) // accessed
+#define PTE_D (1L << 7) // dirty
 
 
 
-#if defined(LAB_MMAP) || defined(LAB_PGTBL)
+// a valid PTE with any of R, W, X set is a leaf;
+// otherwise it points to a lower-level page table.
 #define PTE_LEAF(pte) (((pte) & PTE_R) | ((pte) & PTE_W) | ((pte) & PTE_X))
-#endif
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
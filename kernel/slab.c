@@ -0,0 +1,120 @@
+// Slab allocator for small fixed-size kernel objects,
+// such as struct proc.
+//
+// Each slab is one page from kalloc(): a struct slab header
+// followed by as many objects as fit. Free objects in a slab
+// are chained through their first word. A cache only keeps
+// the slabs that have free objects on its list; a slab whose
+// objects are all free is handed straight back to kfree(),
+// so memory follows the number of live objects.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "slab.h"
+
+struct slab {
+  struct slab *next;   // next slab on cache's list
+  struct slab *prev;
+  uint nfree;          // number of free objects in this slab
+  void *freelist;      // first free object
+};
+
+// objects start after the header, 16-byte aligned.
+#define SLABHDR ((sizeof(struct slab) + 15) & ~15)
+#define SLABOBJS(s) ((char*)(s) + SLABHDR)
+
+void
+kcacheinit(struct kcache *kc, char *name, uint size)
+{
+  initlock(&kc->lock, "kcache");
+  kc->name = name;
+  kc->size = (size + 7) & ~7;
+  kc->perslab = (PGSIZE - SLABHDR) / kc->size;
+  if(kc->perslab == 0)
+    panic("kcacheinit: object too big");
+  kc->slabs = 0;
+}
+
+static void
+slabunlink(struct kcache *kc, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    kc->slabs = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = 0;
+}
+
+static void
+slabpush(struct kcache *kc, struct slab *s)
+{
+  s->prev = 0;
+  s->next = kc->slabs;
+  if(kc->slabs)
+    kc->slabs->prev = s;
+  kc->slabs = s;
+}
+
+// Allocate one zeroed object from kc.
+// Returns 0 if a new slab was needed but memory is exhausted.
+void*
+kcachealloc(struct kcache *kc)
+{
+  struct slab *s;
+  char *o;
+  int i;
+
+  acquire(&kc->lock);
+  if((s = kc->slabs) == 0){
+    release(&kc->lock);
+    if((s = (struct slab*)kalloc()) == 0)
+      return 0;
+    s->nfree = kc->perslab;
+    s->freelist = 0;
+    for(i = kc->perslab - 1; i >= 0; i--){
+      o = SLABOBJS(s) + i * kc->size;
+      *(void**)o = s->freelist;
+      s->freelist = o;
+    }
+    acquire(&kc->lock);
+    slabpush(kc, s);
+  }
+
+  o = s->freelist;
+  s->freelist = *(void**)o;
+  if(--s->nfree == 0)
+    slabunlink(kc, s);
+  release(&kc->lock);
+
+  memset(o, 0, kc->size);
+  return o;
+}
+
+// Return object o, which came from kcachealloc(kc).
+void
+kcachefree(struct kcache *kc, void *o)
+{
+  struct slab *s = (struct slab*)PGROUNDDOWN((uint64)o);
+
+  if(((char*)o - SLABOBJS(s)) % kc->size != 0)
+    panic("kcachefree");
+
+  acquire(&kc->lock);
+  *(void**)o = s->freelist;
+  s->freelist = o;
+  if(s->nfree++ == 0)
+    slabpush(kc, s);
+  if(s->nfree == kc->perslab){
+    slabunlink(kc, s);
+    release(&kc->lock);
+    kfree(s);
+    return;
+  }
+  release(&kc->lock);
+}
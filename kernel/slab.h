@@ -0,0 +1,9 @@
+// A cache of equal-sized kernel objects, carved out of
+// whole pages from kalloc(). See slab.c.
+struct kcache {
+  struct spinlock lock;
+  char *name;          // Name of cache (debugging)
+  uint size;           // Bytes per object, rounded up to 8
+  uint perslab;        // Objects that fit in one slab page
+  struct slab *slabs;  // Slabs with at least one free object
+};
@@ -9,3 +9,12 @@ struct stat {
   short nlink; // Number of links to file
   uint64 size; // Size of file in bytes
 };
+
+// A directory entry as returned by getdents().
+struct dirstat {
+  uint ino;      // Inode number
+  short type;    // Type of file
+  short nlink;   // Number of links to file
+  uint64 size;   // Size of file in bytes
+  char name[16]; // Name, NUL-terminated
+};
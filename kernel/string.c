@@ -1,13 +1,42 @@
 #include "types.h"
 
+// memset, memcmp and memmove work a word (8 bytes) at a time,
+// unrolled eight words to a loop, once dst (and src) reach an
+// 8-byte boundary. They fall back to bytes for the unaligned
+// head and tail, and when dst and src are differently aligned.
+
+// may_alias, since these words overlay arbitrary objects.
+typedef uint64 __attribute__((may_alias)) word;
+
+#define WSIZE sizeof(word)
+#define WALIGNED(p) (((uint64)(p) & (WSIZE-1)) == 0)
+
 void*
 memset(void *dst, int c, uint n)
 {
   char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  word *w, x;
+
+  while(n > 0 && !WALIGNED(cdst)){
+    *cdst++ = c;
+    n--;
+  }
+
+  x = (uchar)c;
+  x |= x << 8;
+  x |= x << 16;
+  x |= x << 32;
+  w = (word*)cdst;
+  for(; n >= 8*WSIZE; n -= 8*WSIZE, w += 8){
+    w[0] = x; w[1] = x; w[2] = x; w[3] = x;
+    w[4] = x; w[5] = x; w[6] = x; w[7] = x;
   }
+  for(; n >= WSIZE; n -= WSIZE)
+    *w++ = x;
+
+  cdst = (char*)w;
+  while(n-- > 0)
+    *cdst++ = c;
   return dst;
 }
 
@@ -18,6 +47,19 @@ memcmp(const void *v1, const void *v2, uint n)
 
   s1 = v1;
   s2 = v2;
+  if(((uint64)s1 & (WSIZE-1)) == ((uint64)s2 & (WSIZE-1))){
+    while(n > 0 && !WALIGNED(s1)){
+      if(*s1 != *s2)
+        return *s1 - *s2;
+      s1++, s2++, n--;
+    }
+    // skip equal words; the bytes below find the difference.
+    while(n >= WSIZE && *(word*)s1 == *(word*)s2){
+      s1 += WSIZE;
+      s2 += WSIZE;
+      n -= WSIZE;
+    }
+  }
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -32,20 +74,64 @@ memmove(void *dst, const void *src, uint n)
 {
   const char *s;
   char *d;
+  const word *ws;
+  word *wd;
+  int words;
 
   if(n == 0)
     return dst;
   
   s = src;
   d = dst;
+  words = ((uint64)s & (WSIZE-1)) == ((uint64)d & (WSIZE-1));
   if(s < d && s + n > d){
+    // overlapping, with dst above src: copy backwards.
     s += n;
     d += n;
+    if(words){
+      while(n > 0 && !WALIGNED(d)){
+        *--d = *--s;
+        n--;
+      }
+      ws = (const word*)s;
+      wd = (word*)d;
+      for(; n >= 8*WSIZE; n -= 8*WSIZE){
+        ws -= 8;
+        wd -= 8;
+        wd[7] = ws[7]; wd[6] = ws[6]; wd[5] = ws[5]; wd[4] = ws[4];
+        wd[3] = ws[3]; wd[2] = ws[2]; wd[1] = ws[1]; wd[0] = ws[0];
+      }
+      for(; n >= WSIZE; n -= WSIZE)
+        *--wd = *--ws;
+      s = (const char*)ws;
+      d = (char*)wd;
+    }
     while(n-- > 0)
       *--d = *--s;
-  } else
+  } else {
+    if(words){
+      while(n > 0 && !WALIGNED(d)){
+        *d++ = *s++;
+        n--;
+      }
+      ws = (const word*)s;
+      wd = (word*)d;
+      // loads before stores, so that overlapping moves
+      // down by less than 64 bytes stay correct.
+      for(; n >= 8*WSIZE; n -= 8*WSIZE, ws += 8, wd += 8){
+        word x0 = ws[0], x1 = ws[1], x2 = ws[2], x3 = ws[3];
+        word x4 = ws[4], x5 = ws[5], x6 = ws[6], x7 = ws[7];
+        wd[0] = x0; wd[1] = x1; wd[2] = x2; wd[3] = x3;
+        wd[4] = x4; wd[5] = x5; wd[6] = x6; wd[7] = x7;
+      }
+      for(; n >= WSIZE; n -= WSIZE)
+        *wd++ = *ws++;
+      s = (const char*)ws;
+      d = (char*)wd;
+    }
     while(n-- > 0)
       *d++ = *s++;
+  }
 
   return dst;
 }
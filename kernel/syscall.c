@@ -5,6 +5,8 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "syscall.h"
+#include "sysstat.h"
+#include "trace.h"
 #include "defs.h"
 
 // Fetch the uint64 at addr from the current process.
@@ -101,6 +103,23 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_profread(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_traceread(void);
+extern uint64 sys_ringsetup(void);
+extern uint64 sys_ring_enter(void);
+extern uint64 sys_perf(void);
+extern uint64 sys_getdents(void);
+extern uint64 sys_fstatat(void);
+extern uint64 sys_sendfile(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -126,8 +145,73 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_prof]    sys_prof,
+[SYS_profread] sys_profread,
+[SYS_sysstat] sys_sysstat,
+[SYS_trace]   sys_trace,
+[SYS_traceread] sys_traceread,
+[SYS_ringsetup] sys_ringsetup,
+[SYS_ring_enter] sys_ring_enter,
+[SYS_perf]    sys_perf,
+[SYS_getdents] sys_getdents,
+[SYS_fstatat] sys_fstatat,
+[SYS_sendfile] sys_sendfile,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
 };
 
+// statistics for each system call, kept per CPU so
+// that CPUs don't share cache lines; sysstatread()
+// adds them up.
+static struct sysstat sysstats[NCPU][NELEM(syscalls)];
+
+static void
+sysaccount(int num, uint64 dt)
+{
+  struct sysstat *st;
+  int b;
+
+  push_off();
+  st = &sysstats[cpuid()][num];
+  st->count++;
+  st->time += dt;
+  b = dt > 1 ? 63 - __builtin_clzl(dt) : 0;
+  if(b >= NSYSHIST)
+    b = NSYSHIST - 1;
+  st->hist[b]++;
+  pop_off();
+}
+
+// Copy the statistics for system calls 0 to n-1, summed
+// over CPUs, to user address addr. Returns the number
+// of system calls copied, at most n.
+int
+sysstatread(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct sysstat st;
+  int num, c, i;
+
+  if(n > NELEM(syscalls))
+    n = NELEM(syscalls);
+  for(num = 0; num < n; num++){
+    memset(&st, 0, sizeof(st));
+    for(c = 0; c < NCPU; c++){
+      st.count += sysstats[c][num].count;
+      st.time += sysstats[c][num].time;
+      for(i = 0; i < NSYSHIST; i++)
+        st.hist[i] += sysstats[c][num].hist[i];
+    }
+    if(copyout(p->pagetable, addr + num*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return n;
+}
+
 void
 syscall(void)
 {
@@ -138,7 +222,26 @@ syscall(void)
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
     // and store its return value in p->trapframe->a0
+    struct tracerec t;
+    int traced = (p->tracemask & (1L << num)) != 0;
+    if(traced){
+      t.args[0] = p->trapframe->a0;
+      t.args[1] = p->trapframe->a1;
+      t.args[2] = p->trapframe->a2;
+    }
+    uint64 t0 = r_time();
     p->trapframe->a0 = syscalls[num]();
+    uint64 dt = r_time() - t0;
+    sysaccount(num, dt);
+    if(traced){
+      t.time = t0;
+      t.dur = dt;
+      t.ret = p->trapframe->a0;
+      t.pid = p->pid;
+      t.tracer = p->tracer;
+      t.num = num;
+      tracelog(&t);
+    }
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
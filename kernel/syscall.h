@@ -20,3 +20,20 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_prof   22
+#define SYS_profread 23
+#define SYS_sysstat 24
+#define SYS_trace  25
+#define SYS_traceread 26
+#define SYS_ringsetup 27
+#define SYS_ring_enter 28
+#define SYS_perf   29
+#define SYS_getdents 30
+#define SYS_fstatat 31
+#define SYS_sendfile 32
+#define SYS_pread  33
+#define SYS_pwrite 34
+#define SYS_readv  35
+#define SYS_writev 36
+#define SYS_mmap   37
+#define SYS_munmap 38
@@ -15,6 +15,18 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "memlayout.h"
+#include "ring.h"
+#include "uio.h"
+
+// The open file for descriptor fd, or 0 if none.
+static struct file*
+fdfile(int fd)
+{
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  return myproc()->ofile[fd];
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -25,7 +37,7 @@ argfd(int n, int *pfd, struct file **pf)
   struct file *f;
 
   argint(n, &fd);
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((f = fdfile(fd)) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -94,6 +106,84 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// Like read() and write(), but at offset off, neither
+// using nor moving the file's own offset.
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  argaddr(1, &p);
+  argint(2, &n);
+  argint(3, &off);
+  if(argfd(0, 0, &f) < 0 || off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  argaddr(1, &p);
+  argint(2, &n);
+  argint(3, &off);
+  if(argfd(0, 0, &f) < 0 || off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
+// Fetch the iovec array for readv() or writev()
+// into iov. Returns the number of buffers, or -1.
+static int
+argiov(struct iovec *iov)
+{
+  uint64 uiov, total = 0;
+  int i, cnt;
+
+  argaddr(1, &uiov);
+  argint(2, &cnt);
+  if(cnt < 0 || cnt > IOV_MAX)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, uiov, cnt * sizeof(*iov)) < 0)
+    return -1;
+  for(i = 0; i < cnt; i++){
+    total += iov[i].iov_len;
+    if(iov[i].iov_len > 0x7fffffff || total > 0x7fffffff)
+      return -1;
+  }
+  return cnt;
+}
+
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || (cnt = argiov(iov)) < 0)
+    return -1;
+  return filereadv(f, iov, cnt);
+}
+
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || (cnt = argiov(iov)) < 0)
+    return -1;
+  return filewritev(f, iov, cnt);
+}
+
 uint64
 sys_close(void)
 {
@@ -119,6 +209,114 @@ sys_fstat(void)
   return filestat(f, st);
 }
 
+// Read up to n entries of a directory, with their types
+// and sizes, saving a stat() by path of each.
+uint64
+sys_getdents(void)
+{
+  struct file *f;
+  uint64 ds; // user pointer to array of struct dirstat
+  int n;
+
+  argaddr(1, &ds);
+  argint(2, &n);
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  return filegetdents(f, ds, n);
+}
+
+// Stat path, looked up relative to the directory open
+// as dirfd, or the current directory for AT_FDCWD.
+uint64
+sys_fstatat(void)
+{
+  char path[MAXPATH];
+  struct file *f;
+  struct inode *dp, *ip;
+  struct stat st;
+  uint64 ust; // user pointer to struct stat
+  int dirfd;
+
+  argint(0, &dirfd);
+  argaddr(2, &ust);
+  if(argstr(1, path, MAXPATH) < 0)
+    return -1;
+  if(dirfd == AT_FDCWD)
+    dp = myproc()->cwd;
+  else if((f = fdfile(dirfd)) != 0 && f->type == FD_INODE)
+    dp = f->ip;
+  else
+    return -1;
+
+  begin_op();
+  if((ip = nameiat(dp, path)) == 0){
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+  stati(ip, &st);
+  iunlockput(ip);
+  end_op();
+  if(copyout(myproc()->pagetable, ust, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// Copy up to n bytes from file in_fd to out_fd inside the
+// kernel. If poff is not 0, the copy starts at *poff, which is
+// advanced, and in_fd's offset is left alone; otherwise it
+// starts at and advances in_fd's offset, like read().
+uint64
+sys_sendfile(void)
+{
+  struct file *out, *in;
+  uint64 poff; // user pointer to uint offset
+  uint off;
+  int n, r;
+
+  argaddr(2, &poff);
+  argint(3, &n);
+  if(argfd(0, 0, &out) < 0 || argfd(1, 0, &in) < 0)
+    return -1;
+  if(poff == 0)
+    return filesend(out, in, &in->off, n);
+
+  if(copyin(myproc()->pagetable, (char*)&off, poff, sizeof(off)) < 0)
+    return -1;
+  r = filesend(out, in, &off, n);
+  if(copyout(myproc()->pagetable, poff, (char*)&off, sizeof(off)) < 0)
+    return -1;
+  return r;
+}
+
+// Map a file into memory; the address is ignored,
+// and the kernel picks one. See vma.c.
+uint64
+sys_mmap(void)
+{
+  struct file *f;
+  uint64 len;
+  int prot, flags, off;
+
+  argaddr(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argint(5, &off);
+  if(argfd(4, 0, &f) < 0 || off < 0)
+    return -1;
+  return vmamap(myproc(), f, len, prot, flags, off);
+}
+
+uint64
+sys_munmap(void)
+{
+  uint64 addr, len;
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  return vmaunmap(myproc(), addr, len);
+}
+
 // Create the path new as a link to the same inode as old.
 uint64
 sys_link(void)
@@ -301,18 +499,13 @@ create(char *path, short type, short major, short minor)
   return 0;
 }
 
-uint64
-sys_open(void)
+// Open path with mode omode, for open() and ring_enter().
+static int
+openpath(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  argint(1, &omode);
-  if((n = argstr(0, path, MAXPATH)) < 0)
-    return -1;
 
   begin_op();
 
@@ -370,6 +563,18 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  argint(1, &omode);
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  return openpath(path, omode);
+}
+
 uint64
 sys_mkdir(void)
 {
@@ -503,3 +708,98 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// Map a submission/completion ring into the calling process,
+// if it does not have one. Returns its user address.
+uint64
+sys_ringsetup(void)
+{
+  struct proc *p = myproc();
+
+  if(p->ring == 0){
+    if(proc_ring(p) < 0)
+      return -1;
+    p->asid = 0;
+  }
+  return USERRING;
+}
+
+// Run one submission, which the caller has copied out of
+// the shared page so that the process cannot change it
+// while the kernel looks at it.
+static int
+ringop(struct sqe *e)
+{
+  char path[MAXPATH];
+  struct file *f = 0;
+  int fd;
+
+  if(e->flags != 0)
+    return -1;
+
+  switch(e->op){
+  case RING_NOP:
+    return 0;
+  case RING_OPEN:
+    if(fetchstr(e->addr, path, MAXPATH) < 0)
+      return -1;
+    return openpath(path, e->n);
+  }
+
+  if((f = fdfile(e->fd)) == 0)
+    return -1;
+  switch(e->op){
+  case RING_READ:
+    return fileread(f, e->addr, e->n);
+  case RING_WRITE:
+    return filewrite(f, e->addr, e->n);
+  case RING_FSTAT:
+    return filestat(f, e->addr);
+  case RING_CLOSE:
+    fd = e->fd;
+    myproc()->ofile[fd] = 0;
+    fileclose(f);
+    return 0;
+  }
+  return -1;
+}
+
+// Run up to n submissions from the calling process's ring,
+// in order, posting a completion for each. Stops early if
+// the completion queue is full or the process is killed.
+// Returns the number of submissions consumed.
+uint64
+sys_ring_enter(void)
+{
+  struct proc *p = myproc();
+  struct ring *r = p->ring;
+  struct sqe e;
+  struct cqe *c;
+  uint head, tail, ctail;
+  int i, n;
+
+  argint(0, &n);
+  if(r == 0 || n < 0)
+    return -1;
+
+  // the process can write any of these words at any time;
+  // the worst it can do is make us run its own entries
+  // again, and every index is taken modulo NRING.
+  head = r->sqhead;
+  tail = __atomic_load_n(&r->sqtail, __ATOMIC_ACQUIRE);
+  ctail = r->cqtail;
+  for(i = 0; i < n && head != tail; i++){
+    if(ctail - __atomic_load_n(&r->cqhead, __ATOMIC_ACQUIRE) >= NRING)
+      break;
+    if(killed(p))
+      break;
+    e = r->sq[head % NRING];
+    c = &r->cq[ctail % NRING];
+    c->data = e.data;
+    c->res = ringop(&e);
+    c->pad = 0;
+    __atomic_store_n(&r->cqtail, ++ctail, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->sqhead, ++head, __ATOMIC_RELEASE);
+  }
+  return i;
+}
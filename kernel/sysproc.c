@@ -5,6 +5,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "perf.h"
 
 uint64
 sys_exit(void)
@@ -91,3 +92,91 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// turn the sampling profiler on or off.
+uint64
+sys_prof(void)
+{
+  int on;
+
+  argint(0, &on);
+  return profctl(on);
+}
+
+// copy out profiler samples.
+uint64
+sys_profread(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return profread(addr, n);
+}
+
+// copy out per-system-call statistics.
+uint64
+sys_sysstat(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return sysstatread(addr, n);
+}
+
+// trace the system calls in mask, 1<<SYS_xxx, made by
+// child pid and the children it forks from now on.
+uint64
+sys_trace(void)
+{
+  int pid;
+  uint64 mask;
+
+  argint(0, &pid);
+  argaddr(1, &mask);
+  return traceattach(pid, mask);
+}
+
+// copy out traced system call records.
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return traceread(addr, n);
+}
+
+// Copy the calling process's hardware counter totals,
+// including the current time slice, to a struct perfcount.
+uint64
+sys_perf(void)
+{
+  struct proc *p = myproc();
+  struct perfcount pc;
+  struct cpu *c;
+  uint64 addr;
+
+  argaddr(0, &addr);
+  push_off();
+  c = mycpu();
+  pc.cycles = p->cycles + r_cycle() - c->cycles0;
+  pc.instret = p->instret + r_instret() - c->instret0;
+  pop_off();
+  pc.ccycles = p->ccycles;
+  pc.cinstret = p->cinstret;
+  if(copyout(p->pagetable, addr, (char*)&pc, sizeof(pc)) < 0)
+    return -1;
+  return 0;
+}
@@ -0,0 +1,8 @@
+// Per-system-call statistics, as returned by sysstat().
+#define NSYSHIST 32
+
+struct sysstat {
+  uint64 count;           // calls that returned
+  uint64 time;            // total r_time() units spent in them
+  uint64 hist[NSYSHIST];  // calls taking [2^i, 2^(i+1)) units; 0 and 1 in hist[0]
+};
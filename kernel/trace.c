@@ -0,0 +1,138 @@
+//
+// System call tracing. syscall() logs a record for each
+// call made by a process whose p->tracemask has the call's
+// bit set, in a ring for the current CPU, without taking a
+// lock: only that CPU writes to its ring, and it leaves
+// records alone until traceread() has freed their slots.
+// Records are dropped while a ring is full.
+//
+// Each record is for the tracer that attached to the
+// process with trace(), and traceread() returns only the
+// caller's, skipping over others' records to find them.
+// It marks the records it has read, and a ring's slots are
+// freed once the records before them have all been read,
+// or belong to tracers that have exited. A tracer learns
+// that its processes have all exited from its count of
+// them, p->ntraced, not from their exit records, which
+// may have been dropped.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+
+#define NTRACE 128    // records per CPU
+
+struct tracecpu {
+  struct tracerec rec[NTRACE];
+  uint64 w;           // records logged; written only by this CPU
+  uint64 r;           // slots freed; written only by traceread()
+  uint64 dropped;
+};
+
+static struct tracecpu tracecpus[NCPU];
+
+// serializes readers.
+static struct spinlock tracelock;
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Log record t in this CPU's ring.
+// Returns 1, or 0 if the ring was full.
+int
+tracelog(struct tracerec *t)
+{
+  struct tracecpu *c;
+  uint64 w;
+  int ok = 0;
+
+  push_off();
+  c = &tracecpus[cpuid()];
+  w = c->w;
+  if(w - __atomic_load_n(&c->r, __ATOMIC_ACQUIRE) >= NTRACE){
+    c->dropped++;
+  } else {
+    t->cpu = cpuid();
+    c->rec[w % NTRACE] = *t;
+    __atomic_store_n(&c->w, w + 1, __ATOMIC_RELEASE);
+    ok = 1;
+  }
+  pop_off();
+  return ok;
+}
+
+// Copy up to n of the caller's records to user address
+// addr, oldest first, consuming them. Returns the number
+// copied, which is 0 if there are none yet, or -1 if there
+// are none and the caller traces no live process.
+int
+traceread(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct tracecpu *c, *best;
+  struct tracerec *t;
+  uint64 w, pos[NCPU];
+  int i, tot = 0, live;
+
+  if(vmaprefault(p, addr, (uint64)n * sizeof(struct tracerec), 1) < 0)
+    return -1;
+  // counted before looking at the rings, so that if it is
+  // 0, every record logged before the last exit is seen.
+  live = tracecount(p->pid, 0);
+  acquire(&tracelock);
+  for(c = tracecpus; c < &tracecpus[NCPU]; c++)
+    pos[c - tracecpus] = c->r;
+  for(;;){
+    // the CPU with the earliest unread record for p. pos[]
+    // is each ring's first record for p not yet looked at.
+    best = 0;
+    for(c = tracecpus; c < &tracecpus[NCPU]; c++){
+      i = c - tracecpus;
+      w = __atomic_load_n(&c->w, __ATOMIC_ACQUIRE);
+      while(pos[i] != w && c->rec[pos[i] % NTRACE].tracer != p->pid)
+        pos[i]++;
+      if(pos[i] == w)
+        continue;
+      t = &c->rec[pos[i] % NTRACE];
+      if(best == 0 || t->time < best->rec[pos[best - tracecpus] % NTRACE].time)
+        best = c;
+    }
+    if(best == 0 || tot == n)
+      break;
+    t = &best->rec[pos[best - tracecpus] % NTRACE];
+    if(copyout(p->pagetable, addr + tot*sizeof(struct tracerec),
+               (char*)t, sizeof(struct tracerec)) < 0){
+      release(&tracelock);
+      return -1;
+    }
+    // read; tracelog() leaves the slot alone until best->r
+    // passes it below.
+    t->tracer = 0;
+    pos[best - tracecpus]++;
+    tot++;
+  }
+  // free the slots at each ring's head that have been read,
+  // or whose tracer has exited.
+  for(c = tracecpus; c < &tracecpus[NCPU]; c++){
+    w = __atomic_load_n(&c->w, __ATOMIC_ACQUIRE);
+    while(c->r != w){
+      t = &c->rec[c->r % NTRACE];
+      if(t->tracer != 0 && tracecount(t->tracer, 0) >= 0)
+        break;
+      __atomic_store_n(&c->r, c->r + 1, __ATOMIC_RELEASE);
+    }
+  }
+  release(&tracelock);
+  if(tot == 0 && best == 0 && live == 0)
+    return -1;
+  return tot;
+}
@@ -0,0 +1,11 @@
+// A system call traced by trace(); see trace.c.
+struct tracerec {
+  uint64 time;      // r_time() at entry
+  uint64 dur;       // r_time() units spent in the call
+  uint64 args[3];   // first three arguments
+  uint64 ret;       // return value
+  int pid;
+  int tracer;       // pid of the process that reads it
+  short num;        // system call number
+  short cpu;        // CPU the call returned on
+};
@@ -5,10 +5,19 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "usyscall.h"
 
 struct spinlock tickslock;
 uint ticks;
 
+// mapped read-only at USHARED in every process.
+struct ushared *ushared;
+
+#ifdef RVV
+// what vsave() stores: four CSRs, then v0-v31.
+#define VSTATESIZE(vlenb) (4*8 + 32*(vlenb))
+#endif
+
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -20,6 +29,11 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+
+  if((ushared = (struct ushared*)kalloc()) == 0)
+    panic("trapinit");
+  memset(ushared, 0, PGSIZE);
+  ushared->timefreq = 10000000;   // qemu's virt machine
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -27,6 +41,15 @@ void
 trapinithart(void)
 {
   w_stvec((uint64)kernelvec);
+
+#ifdef RVV
+  if(VSTATESIZE(vlenb()) > PGSIZE)
+    panic("trapinithart: vectors too long");
+#endif
+
+  // let user code read time, for clock_gettime(),
+  // and the cycle and instret counters.
+  w_scounteren(r_scounteren() | COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
 }
 
 //
@@ -49,6 +72,12 @@ usertrap(void)
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
+
+#ifdef RVV
+  // another process may run before this one returns.
+  if((r_sstatus() & SSTATUS_VS) == SSTATUS_VS_DIRTY)
+    vsave(p->vstate);
+#endif
   
   if(r_scause() == 8){
     // system call
@@ -66,7 +95,19 @@ usertrap(void)
 
     syscall();
   } else if((which_dev = devintr()) != 0){
-    // ok
+    if(which_dev >= 2)
+      profsample(1, p->trapframe->epc, p->trapframe->s0);
+  } else if((r_scause() == 12 || r_scause() == 13 || r_scause() == 15) &&
+            vmafault(p, r_stval(), r_scause()) == 0){
+    // a page of a mapped file, now faulted in.
+#ifdef RVV
+  } else if(r_scause() == 2 && p->vstate == 0 &&
+            (p->vstate = kalloc()) != 0){
+    // an illegal instruction, perhaps the process's first
+    // vector instruction: give it vector state and retry.
+    // if it traps again, p->vstate is set and it dies.
+    memset(p->vstate, 0, PGSIZE);
+#endif
   } else {
     printf("usertrap(): unexpected scause 0x%lx pid=%d\n", r_scause(), p->pid);
     printf("            sepc=0x%lx stval=0x%lx\n", r_sepc(), r_stval());
@@ -114,13 +155,23 @@ usertrapret(void)
   unsigned long x = r_sstatus();
   x &= ~SSTATUS_SPP; // clear SPP to 0 for user mode
   x |= SSTATUS_SPIE; // enable interrupts in user mode
+  x &= ~SSTATUS_VS;  // vector instructions trap, unless...
+#ifdef RVV
+  if(p->vstate){
+    // ...the process uses them: reload its registers.
+    w_sstatus(x | SSTATUS_VS_INITIAL);
+    vrestore(p->vstate);
+    x |= SSTATUS_VS_CLEAN;
+  }
+#endif
   w_sstatus(x);
 
   // set S Exception Program Counter to the saved user pc.
   w_sepc(p->trapframe->epc);
 
-  // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  // tell trampoline.S the user page table to switch to,
+  // tagged with the process's ASID.
+  uint64 satp = proc_satp(p);
 
   // jump to userret in trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
@@ -150,6 +201,11 @@ kerneltrap()
     panic("kerneltrap");
   }
 
+  // kernelvec doesn't touch s0, so the interrupted code's
+  // frame pointer is the one saved in kerneltrap()'s frame.
+  if(which_dev >= 2)
+    profsample(0, sepc, *(uint64*)(r_fp() - 16));
+
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2 && myproc() != 0)
     yield();
@@ -160,25 +216,43 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
+// returns 1 if a clock tick is due, 0 if the interrupt
+// is only for the profiler.
+int
 clockintr()
 {
-  if(cpuid() == 0){
-    acquire(&tickslock);
-    ticks++;
-    wakeup(&ticks);
-    release(&tickslock);
+  struct cpu *c = mycpu();
+  uint64 now = r_time(), next;
+  int tick = 0;
+
+  if(now >= c->nexttick){
+    tick = 1;
+    if(cpuid() == 0){
+      acquire(&tickslock);
+      ticks++;
+      __atomic_store_n(&ushared->ticks, ticks, __ATOMIC_RELAXED);
+      wakeup(&ticks);
+      release(&tickslock);
+    }
+    // 1000000 is about a tenth of a second.
+    c->nexttick = now + 1000000;
   }
 
   // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  // the interrupt request. the profiler samples more
+  // often than the clock ticks.
+  next = c->nexttick;
+  if(profon && now + PROFINTERVAL < next)
+    next = now + PROFINTERVAL;
+  w_stimecmp(next);
+
+  return tick;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
+// returns 2 if timer interrupt (a clock tick),
+// 3 if a timer interrupt just for the profiler,
 // 1 if other device,
 // 0 if not recognized.
 int
@@ -209,8 +283,7 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000005L){
     // timer interrupt.
-    clockintr();
-    return 2;
+    return clockintr() ? 2 : 3;
   } else {
     return 0;
   }
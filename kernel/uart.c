@@ -40,14 +40,16 @@
 
 // the transmit output buffer.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
+#define UART_TX_BUF_SIZE 1024
 char uart_tx_buf[UART_TX_BUF_SIZE];
 uint64 uart_tx_w; // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
 uint64 uart_tx_r; // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
+int uart_tx_wake; // uartstart() made room; wake up writers
 
 extern volatile int panicked; // from printf.c
 
 void uartstart();
+void uartwakeup();
 
 void
 uartinit(void)
@@ -100,7 +102,57 @@ uartputc(int c)
   uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = c;
   uart_tx_w += 1;
   uartstart();
+  uartwakeup();
+}
+
+// add n characters from buf to the output buffer, as
+// many at a time as there is room for, and tell the
+// UART to start sending. like uartputc(), blocks if
+// the output buffer is full.
+void
+uartwrite(char *buf, int n)
+{
+  int i = 0;
+
+  acquire(&uart_tx_lock);
+
+  if(panicked){
+    for(;;)
+      ;
+  }
+  while(i < n){
+    while(uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE){
+      // buffer is full.
+      // wait for uartstart() to open up space in the buffer.
+      sleep(&uart_tx_r, &uart_tx_lock);
+    }
+    while(i < n && uart_tx_w < uart_tx_r + UART_TX_BUF_SIZE){
+      uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = buf[i++];
+      uart_tx_w += 1;
+    }
+    uartstart();
+  }
+  uartwakeup();
+}
+
+// add up to n characters from buf to the output buffer,
+// as many as there is room for, and return how many.
+// never blocks, and never calls wakeup(), so it can be
+// used by kernel printf() with any locks held; uartintr()
+// does the wakeup later.
+int
+uarttrywrite(char *buf, int n)
+{
+  int i = 0;
+
+  acquire(&uart_tx_lock);
+  while(i < n && uart_tx_w < uart_tx_r + UART_TX_BUF_SIZE){
+    uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = buf[i++];
+    uart_tx_w += 1;
+  }
+  uartstart();
   release(&uart_tx_lock);
+  return i;
 }
 
 
@@ -133,28 +185,47 @@ uartputc_sync(int c)
 void
 uartstart()
 {
+  uint64 r0 = uart_tx_r;
+
   while(1){
     if(uart_tx_w == uart_tx_r){
       // transmit buffer is empty.
       ReadReg(ISR);
-      return;
+      break;
     }
     
     if((ReadReg(LSR) & LSR_TX_IDLE) == 0){
       // the UART transmit holding register is full,
       // so we cannot give it another byte.
       // it will interrupt when it's ready for a new byte.
-      return;
+      break;
     }
     
     int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
     uart_tx_r += 1;
     
-    // maybe uartputc() is waiting for space in the buffer.
-    wakeup(&uart_tx_r);
-    
     WriteReg(THR, c);
   }
+
+  // maybe uartputc() or uartwrite() is waiting
+  // for space in the buffer.
+  if(uart_tx_r != r0)
+    uart_tx_wake = 1;
+}
+
+// release uart_tx_lock, then wake up writers waiting for
+// space if uartstart() has made some. wakeup() is called
+// without uart_tx_lock so that kernel printf(), which
+// takes uart_tx_lock, can be used with proc locks held.
+void
+uartwakeup()
+{
+  int wake = uart_tx_wake;
+
+  uart_tx_wake = 0;
+  release(&uart_tx_lock);
+  if(wake)
+    wakeup(&uart_tx_r);
 }
 
 // read one input character from the UART.
@@ -184,8 +255,10 @@ uartintr(void)
     consoleintr(c);
   }
 
-  // send buffered characters.
+  // refill the output buffer from the kernel log,
+  // and send buffered characters.
+  kmsgdrain();
   acquire(&uart_tx_lock);
   uartstart();
-  release(&uart_tx_lock);
+  uartwakeup();
 }
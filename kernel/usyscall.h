@@ -0,0 +1,13 @@
+// Pages the kernel maps read-only into every process, so that
+// ulib can answer some system calls with a plain load.
+
+// at USYSCALL, one per process.
+struct usyscall {
+  int pid;
+};
+
+// at USHARED, the same page in every process.
+struct ushared {
+  uint ticks;           // as returned by the uptime() system call
+  uint64 timefreq;      // rate of the time CSR, in Hz
+};
@@ -3,6 +3,8 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -11,6 +13,18 @@
  */
 pagetable_t kernel_pagetable;
 
+// after boot, kernel stacks are mapped and unmapped in
+// kernel_pagetable as processes come and go. kvmlock
+// serializes those changes, and kvmgen counts them so
+// that each hart can tell when its TLB is out of date.
+struct spinlock kvmlock;
+uint64 kvmgen;
+static uint64 hartgen[NCPU];  // kvmgen as of each hart's last flush
+
+// largest ASID the harts implement, or 0 if they
+// have none. see proc_satp().
+uint64 asidmax;
+
 extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
@@ -37,15 +51,16 @@ kvmmake(void)
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
   // map kernel data and the physical RAM we'll make use of.
+  // mappages() uses superpages for the 2-megabyte-aligned
+  // part, which keeps this map small and TLB-friendly.
   kvmmap(kpgtbl, (uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W);
 
   // map the trampoline for trap entry/exit to
   // the highest virtual address in the kernel.
   kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
 
-  // allocate and map a kernel stack for each process.
-  proc_mapstacks(kpgtbl);
-  
+  // kernel stacks are mapped on demand by kvmmapstack().
+
   return kpgtbl;
 }
 
@@ -53,9 +68,62 @@ kvmmake(void)
 void
 kvminit(void)
 {
+  initlock(&kvmlock, "kvm");
   kernel_pagetable = kvmmake();
 }
 
+// Allocate a page for a kernel stack and map it at va.
+// The page below va is left unmapped as a guard page.
+// Returns 0 on success, -1 if out of memory.
+int
+kvmmapstack(uint64 va)
+{
+  char *pa;
+
+  if((pa = kalloc()) == 0)
+    return -1;
+  acquire(&kvmlock);
+  if(mappages(kernel_pagetable, va, PGSIZE, (uint64)pa, PTE_R | PTE_W) != 0){
+    release(&kvmlock);
+    kfree(pa);
+    return -1;
+  }
+  __sync_synchronize();
+  kvmgen++;
+  release(&kvmlock);
+  return 0;
+}
+
+// Unmap the kernel stack at va and free its page.
+// The stack must no longer be in use on any hart.
+void
+kvmunmapstack(uint64 va)
+{
+  acquire(&kvmlock);
+  uvmunmap(kernel_pagetable, va, 1, 1);
+  __sync_synchronize();
+  kvmgen++;
+  release(&kvmlock);
+}
+
+// Flush this hart's TLB if kernel_pagetable has changed
+// since the last flush. The scheduler calls this before
+// running a process, so that the process's kernel stack
+// is mapped as in kernel_pagetable.
+// Interrupts must be disabled.
+void
+kvmsync(void)
+{
+  int id = cpuid();
+  uint64 gen = kvmgen;
+
+  if(hartgen[id] != gen){
+    __sync_synchronize();
+    sfence_vma_asid(0);  // the kernel's entries are all tagged 0
+    hartgen[id] = gen;
+  }
+}
+
 // Switch h/w page table register to the kernel's page table,
 // and enable paging.
 void
@@ -64,6 +132,12 @@ kvminithart()
   // wait for any previous writes to the page table memory to finish.
   sfence_vma();
 
+  // find out how many ASID bits are implemented;
+  // the others read back as zero.
+  w_satp(MAKE_SATP_ASID(kernel_pagetable, 0xFFFF));
+  asidmax = (r_satp() & SATP_ASID_MASK) >> SATP_ASID_SHIFT;
+
+  // the kernel runs with ASID 0.
   w_satp(MAKE_SATP(kernel_pagetable));
 
   // flush stale entries from the TLB.
@@ -82,6 +156,9 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// A leaf PTE in a level-1 page maps a whole 2-megabyte
+// superpage; if walk() meets one, it returns that PTE.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
 {
@@ -91,6 +168,8 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
   for(int level = 2; level > 0; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(PTE_LEAF(*pte))
+        return pte;
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
@@ -102,26 +181,70 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
   return &pagetable[PX(0, va)];
 }
 
-// Look up a virtual address, return the physical address,
-// or 0 if not mapped.
+// Return the address of the level-1 PTE for va, the one
+// that maps a superpage. If alloc!=0, create the level-1
+// page-table page if required.
+static pte_t *
+superwalk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  pte_t *pte;
+
+  if(va >= MAXVA)
+    panic("superwalk");
+
+  pte = &pagetable[PX(2, va)];
+  if(*pte & PTE_V) {
+    if(PTE_LEAF(*pte))
+      panic("superwalk: leaf");
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  } else {
+    if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      return 0;
+    memset(pagetable, 0, PGSIZE);
+    *pte = PA2PTE(pagetable) | PTE_V;
+  }
+  return &pagetable[PX(1, va)];
+}
+
+// Like walk() without alloc, but also set *size to the
+// size of the page that the returned PTE maps:
+// PGSIZE, or SUPERPGSIZE for a superpage.
+pte_t *
+walkpage(pagetable_t pagetable, uint64 va, uint64 *size)
+{
+  pte_t *pte;
+
+  if((pte = superwalk(pagetable, va, 0)) == 0 || (*pte & PTE_V) == 0)
+    return 0;
+  if(PTE_LEAF(*pte)){
+    *size = SUPERPGSIZE;
+    return pte;
+  }
+  *size = PGSIZE;
+  return &((pagetable_t)PTE2PA(*pte))[PX(0, va)];
+}
+
+// Look up a virtual address, return the physical address
+// of its page, or 0 if not mapped.
 // Can only be used to look up user pages.
 uint64
 walkaddr(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
-  uint64 pa;
+  uint64 pa, size;
 
   if(va >= MAXVA)
     return 0;
 
-  pte = walk(pagetable, va, 0);
+  pte = walkpage(pagetable, va, &size);
   if(pte == 0)
     return 0;
   if((*pte & PTE_V) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
-  pa = PTE2PA(*pte);
+  // the 4096-byte page within a superpage.
+  pa = PTE2PA(*pte) + (PGROUNDDOWN(va) & (size - 1));
   return pa;
 }
 
@@ -138,6 +261,8 @@ kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa.
 // va and size MUST be page-aligned.
+// Where va and pa are both superpage-aligned and at least
+// SUPERPGSIZE bytes remain, a single superpage PTE is used.
 // Returns 0 on success, -1 if walk() couldn't
 // allocate a needed page-table page.
 int
@@ -158,6 +283,21 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = va;
   last = va + size - PGSIZE;
   for(;;){
+    if(a % SUPERPGSIZE == 0 && pa % SUPERPGSIZE == 0 &&
+       last - a >= SUPERPGSIZE - PGSIZE){
+      if((pte = superwalk(pagetable, a, 1)) == 0)
+        return -1;
+      if((*pte & PTE_V) == 0){
+        *pte = PA2PTE(pa) | perm | PTE_V;
+        if(a + SUPERPGSIZE - PGSIZE == last)
+          break;
+        a += SUPERPGSIZE;
+        pa += SUPERPGSIZE;
+        continue;
+      }
+      // a level-0 page-table page is already there;
+      // fill it in with ordinary PTEs.
+    }
     if((pte = walk(pagetable, a, 1)) == 0)
       return -1;
     if(*pte & PTE_V)
@@ -171,28 +311,76 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   return 0;
 }
 
+// Replace the superpage PTE *pte with a level-0 page-table
+// page that maps the same memory with 512 ordinary PTEs,
+// so that part of the superpage can be unmapped.
+// Returns 0 on success, -1 if out of memory.
+static int
+splitsuper(pte_t *pte)
+{
+  pagetable_t pagetable;
+  uint64 pa = PTE2PA(*pte);
+  uint flags = PTE_FLAGS(*pte);
+
+  if((pagetable = (pagetable_t)kalloc()) == 0)
+    return -1;
+  for(int i = 0; i < 512; i++)
+    pagetable[i] = PA2PTE(pa + i*PGSIZE) | flags;
+  *pte = PA2PTE(pagetable) | PTE_V;
+  return 0;
+}
+
+// If va lies inside a superpage of pagetable, but not at
+// its start, split the superpage, so that the memory from
+// va on can be unmapped. Returns 0, or -1 if out of memory.
+int
+uvmsplit(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 size;
+
+  if(va % SUPERPGSIZE == 0)
+    return 0;
+  if((pte = walkpage(pagetable, va, &size)) == 0 || size != SUPERPGSIZE)
+    return 0;
+  return splitsuper(pte);
+}
+
 // Remove npages of mappings starting from va. va must be
 // page-aligned. The mappings must exist.
 // Optionally free the physical memory.
+// A superpage that is only partly unmapped is first
+// split into ordinary pages; callers that can't be sure
+// of memory for that split it beforehand with uvmsplit().
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, end, size;
   pte_t *pte;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0)
+  end = va + npages*PGSIZE;
+  for(a = va; a < end; a += size){
+    if((pte = walkpage(pagetable, a, &size)) == 0)
       panic("uvmunmap: walk");
     if((*pte & PTE_V) == 0)
       panic("uvmunmap: not mapped");
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
+    if(size == SUPERPGSIZE && (a % SUPERPGSIZE != 0 || end - a < SUPERPGSIZE)){
+      if(splitsuper(pte) != 0)
+        panic("uvmunmap: split");
+      size = 0;  // look again at a, now an ordinary page
+      continue;
+    }
     if(do_free){
       uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
+      if(size == SUPERPGSIZE)
+        superfree((void*)pa);
+      else
+        kfree((void*)pa);
     }
     *pte = 0;
   }
@@ -229,25 +417,35 @@ uvmfirst(pagetable_t pagetable, uchar *src, uint sz)
 
 // Allocate PTEs and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Each superpage-aligned 2 megabytes that the new region covers
+// gets a superpage if one is free.
 uint64
 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 {
   char *mem;
-  uint64 a;
+  uint64 a, size;
 
   if(newsz < oldsz)
     return oldsz;
 
   oldsz = PGROUNDUP(oldsz);
-  for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+  for(a = oldsz; a < newsz; a += size){
+    size = PGSIZE;
+    if(a % SUPERPGSIZE == 0 && newsz - a >= SUPERPGSIZE &&
+       (mem = superalloc()) != 0)
+      size = SUPERPGSIZE;
+    else
+      mem = kalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
-    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
-      kfree(mem);
+    memset(mem, 0, size);
+    if(mappages(pagetable, a, size, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
+      if(size == SUPERPGSIZE)
+        superfree(mem);
+      else
+        kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
@@ -306,24 +504,46 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 // Given a parent process's page table, copy
 // its memory into a child's page table.
 // Copies both the page table and the
-// physical memory.
+// physical memory, except that read-only
+// pages (program text) are shared.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
   pte_t *pte;
-  uint64 pa, i;
+  uint64 pa, i, size;
   uint flags;
   char *mem;
 
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
+  for(i = 0; i < sz; i += size){
+    if((pte = walkpage(old, i, &size)) == 0)
       panic("uvmcopy: pte should exist");
     if((*pte & PTE_V) == 0)
       panic("uvmcopy: page not present");
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
+    if(size == SUPERPGSIZE){
+      if(i % SUPERPGSIZE == 0 && (mem = superalloc()) != 0){
+        memmove(mem, (char*)pa, SUPERPGSIZE);
+        if(mappages(new, i, SUPERPGSIZE, (uint64)mem, flags) != 0){
+          superfree(mem);
+          goto err;
+        }
+        continue;
+      }
+      // no superpage free: copy the parent's superpage
+      // into ordinary pages, one at a time.
+      pa += i % SUPERPGSIZE;
+      size = PGSIZE;
+    } else if((flags & PTE_W) == 0){
+      kref((void*)pa);
+      if(mappages(new, i, PGSIZE, pa, flags) != 0){
+        kfree((void*)pa);
+        goto err;
+      }
+      continue;
+    }
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
@@ -352,24 +572,47 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
+// Fault in the page at va of a file the current process
+// has mapped, for copyin() or copyout() into its page table.
+// Returns 0 if there is now a page to retry with, -1 if not.
+static int
+uvmfault(pagetable_t pagetable, uint64 va, int write)
+{
+  struct proc *p = myproc();
+
+  // vmafault() may sleep and takes the file's inode lock,
+  // so callers that copy holding a lock fault their pages
+  // in first with vmaprefault(). This catches any that
+  // hold a spinlock and don't.
+  if(p == 0 || p->pagetable != pagetable || !intr_get())
+    return -1;
+  return vmafault(p, va, write ? 15 : 13);
+}
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
 int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
-  uint64 n, va0, pa0;
+  uint64 n, va0, pa0, size;
   pte_t *pte;
+  int faulted = 0;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
     if(va0 >= MAXVA)
       return -1;
-    pte = walk(pagetable, va0, 0);
+    pte = walkpage(pagetable, va0, &size);
     if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 ||
-       (*pte & PTE_W) == 0)
-      return -1;
-    pa0 = PTE2PA(*pte);
+       (*pte & PTE_W) == 0){
+      if(faulted || uvmfault(pagetable, va0, 1) < 0)
+        return -1;
+      faulted = 1;
+      continue;
+    }
+    faulted = 0;
+    pa0 = PTE2PA(*pte) + (va0 & (size - 1));
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -393,6 +636,8 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
     pa0 = walkaddr(pagetable, va0);
+    if(pa0 == 0 && uvmfault(pagetable, va0, 0) == 0)
+      pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -420,6 +665,8 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
     pa0 = walkaddr(pagetable, va0);
+    if(pa0 == 0 && uvmfault(pagetable, va0, 0) == 0)
+      pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -0,0 +1,368 @@
+//
+// Memory-mapped files.
+//
+// mmap() records a region in one of the process's p->vmas
+// and maps nothing; pages are faulted in by vmafault() when
+// the process first touches them. A page that lies within
+// the file comes from the inode's page cache, itext(), the
+// same pages that exec() maps program text from, so mapping
+// a file costs no copy. MAP_SHARED mappings map the cached
+// page itself, read-write if asked, and pages the process
+// has written are written back to the file on munmap() or
+// exit. MAP_PRIVATE mappings map the cached page read-only,
+// and copy it on the first write.
+//
+// writei() copies what it writes into the cached pages, so
+// every shared mapping of a page, and write() and read(),
+// see the same data, and a page written back holds others'
+// changes too. Pages that exec() or a private mapping has
+// mapped are frozen instead: a write drops them from the
+// cache, so running programs and private mappings keep the
+// content they had. So does a write that extends the file
+// into the zero tail of its last page. Either way, a shared
+// mapping of a dropped page keeps the old copy, which it
+// writes back whole on munmap() or exit, undoing writes
+// made since to the same bytes.
+//
+// A process has only one thread, so p->vmas needs no lock.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "stat.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+
+// Return the VMA of p that overlaps [start, end), or 0.
+struct vma*
+vmafind(struct proc *p, uint64 start, uint64 end)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->f && v->start < end && start < v->end)
+      return v;
+  return 0;
+}
+
+// Map len bytes of file f from offset off into p, at the
+// highest free address below USHARED.
+// Returns the address, or -1.
+uint64
+vmamap(struct proc *p, struct file *f, uint64 len, int prot, int flags, uint off)
+{
+  struct vma *v, *free = 0, *o;
+  uint64 start, end;
+
+  if(f->type != FD_INODE || f->ip->type != T_FILE || f->readable == 0)
+    return -1;
+  if((flags & (MAP_SHARED|MAP_PRIVATE)) == 0 ||
+     (flags & (MAP_SHARED|MAP_PRIVATE)) == (MAP_SHARED|MAP_PRIVATE))
+    return -1;
+  if((flags & MAP_SHARED) && (prot & PROT_WRITE) && f->writable == 0)
+    return -1;
+  if(len == 0 || len > USHARED || off % PGSIZE != 0)
+    return -1;
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->f == 0 && free == 0)
+      free = v;
+  if(free == 0)
+    return -1;
+
+  // slide down past the mappings in the way.
+  len = PGROUNDUP(len);
+  end = USHARED;
+  for(;;){
+    if(end < len || end - len < PGROUNDUP(p->sz))
+      return -1;
+    start = end - len;
+    if((o = vmafind(p, start, end)) == 0)
+      break;
+    end = o->start;
+  }
+
+  free->start = start;
+  free->end = end;
+  free->prot = prot;
+  free->flags = flags;
+  free->off = off;
+  free->f = filedup(f);
+  return start;
+}
+
+// Remove the mappings of [start, end) from p's page table,
+// skipping pages that were never faulted in.
+static void
+unmappages(struct proc *p, uint64 start, uint64 end)
+{
+  uint64 a;
+  pte_t *pte;
+
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walk(p->pagetable, a, 0)) != 0 && (*pte & PTE_V)){
+      kfree((void*)PTE2PA(*pte));
+      *pte = 0;
+    }
+  }
+  p->asid = 0;
+}
+
+// Write the pages of shared mapping v in [start, end) that
+// p has written back to the file, up to the file's end.
+// A page is four blocks inside the file, which with the
+// inode and an indirect block fits one transaction.
+static void
+writeback(struct proc *p, struct vma *v, uint64 start, uint64 end)
+{
+  struct inode *ip = v->f->ip;
+  uint64 a;
+  uint off, n;
+  pte_t *pte;
+
+  if((v->flags & MAP_SHARED) == 0 || (v->prot & PROT_WRITE) == 0)
+    return;
+  for(a = start; a < end; a += PGSIZE){
+    pte = walk(p->pagetable, a, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_D) == 0)
+      continue;
+    off = v->off + (a - v->start);
+    begin_op();
+    ilock(ip);
+    if(off < ip->size){
+      n = ip->size - off < PGSIZE ? ip->size - off : PGSIZE;
+      writei(ip, 0, PTE2PA(*pte), off, n);
+    }
+    iunlock(ip);
+    end_op();
+  }
+}
+
+// Unmap [addr, addr+len) from p, writing shared pages back.
+// A mapping may be cut at either end, or split in two.
+// Returns 0, or -1 if a split needs a free VMA and there
+// is none.
+int
+vmaunmap(struct proc *p, uint64 addr, uint64 len)
+{
+  struct vma *v, *free = 0;
+  uint64 start, end, vend;
+
+  if(addr % PGSIZE != 0 || len == 0 || addr + len < addr)
+    return -1;
+  end = PGROUNDUP(addr + len);
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->f == 0 && free == 0)
+      free = v;
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->f && v->start < addr && end < v->end && free == 0)
+      return -1;
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++){
+    if(v->f == 0 || v->end <= addr || end <= v->start)
+      continue;
+    start = addr > v->start ? addr : v->start;
+    vend = end < v->end ? end : v->end;
+    writeback(p, v, start, vend);
+    unmappages(p, start, vend);
+
+    if(start == v->start && vend == v->end){
+      fileclose(v->f);
+      memset(v, 0, sizeof(*v));
+    } else if(start == v->start){
+      v->off += vend - start;
+      v->start = vend;
+    } else if(vend == v->end){
+      v->end = start;
+    } else {
+      // a hole in the middle; free was found above.
+      *free = *v;
+      free->start = vend;
+      free->off += vend - v->start;
+      free->f = filedup(v->f);
+      v->end = start;
+    }
+  }
+  return 0;
+}
+
+// Unmap all of p's mappings, as it exits or execs.
+void
+vmafree(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->f)
+      vmaunmap(p, v->start, v->end - v->start);
+}
+
+// Give child np p's mappings. Pages p has faulted in are
+// shared, except those p has written in private mappings,
+// which are copied. Doesn't sleep, so fork can call it
+// holding np->lock.
+// Returns 0, or -1 if out of memory.
+int
+vmacopy(struct proc *np, struct proc *p)
+{
+  struct vma *v;
+  uint64 a, pa;
+  pte_t *pte;
+  uint flags;
+  char *mem;
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++){
+    if(v->f == 0)
+      continue;
+    for(a = v->start; a < v->end; a += PGSIZE){
+      pte = walk(p->pagetable, a, 0);
+      if(pte == 0 || (*pte & PTE_V) == 0)
+        continue;
+      pa = PTE2PA(*pte);
+      flags = PTE_FLAGS(*pte);
+      if((v->flags & MAP_PRIVATE) && (flags & PTE_W)){
+        if((mem = kalloc()) == 0)
+          goto err;
+        memmove(mem, (char*)pa, PGSIZE);
+        pa = (uint64)mem;
+      } else {
+        kref((void*)pa);
+      }
+      if(mappages(np->pagetable, a, PGSIZE, pa, flags) != 0){
+        kfree((void*)pa);
+        goto err;
+      }
+    }
+  }
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++){
+    np->vmas[v - p->vmas] = *v;
+    if(v->f)
+      filedup(v->f);
+  }
+  return 0;
+
+ err:
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->f)
+      unmappages(np, v->start, v->end);
+  return -1;
+}
+
+// Handle a page fault with cause scause (12, 13 or 15) at
+// va, if va is in one of p's mappings and the mapping allows
+// the access. Also called by copyin() and copyout().
+// Returns 0 if the access can be retried, -1 if not.
+int
+vmafault(struct proc *p, uint64 va, uint64 scause)
+{
+  struct vma *v;
+  struct inode *ip;
+  pte_t *pte;
+  uint64 pa;
+  uint off, n;
+  int perm, own;
+  char *mem;
+
+  va = PGROUNDDOWN(va);
+  if((v = vmafind(p, va, va + PGSIZE)) == 0)
+    return -1;
+  if((scause == 12 && (v->prot & PROT_EXEC) == 0) ||
+     (scause == 13 && (v->prot & (PROT_READ|PROT_WRITE)) == 0) ||
+     (scause == 15 && (v->prot & PROT_WRITE) == 0))
+    return -1;
+
+  if((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V)){
+    if(scause == 15 && (*pte & PTE_W) == 0){
+      // the first write to a private page: copy it.
+      if((mem = kalloc()) == 0)
+        return -1;
+      pa = PTE2PA(*pte);
+      memmove(mem, (char*)pa, PGSIZE);
+      *pte = PA2PTE(mem) | PTE_FLAGS(*pte) | PTE_W | PTE_D;
+      kfree((void*)pa);
+    } else if(scause == 15){
+      // hardware that leaves the dirty bit to software.
+      *pte |= PTE_A | PTE_D;
+    }
+    // in case the TLB holds the old PTE.
+    p->asid = 0;
+    return 0;
+  }
+
+  ip = v->f->ip;
+  off = v->off + (va - v->start);
+  own = 1;
+  ilock(ip);
+  if(off < ip->size){
+    n = ip->size - off < PGSIZE ? ip->size - off : PGSIZE;
+    if((v->flags & MAP_SHARED) || scause != 15){
+      pa = itext(ip, off, n, (v->flags & MAP_PRIVATE) != 0);
+      own = (v->flags & MAP_SHARED) != 0;
+    } else if((pa = (uint64)kalloc()) != 0){
+      memset((char*)pa + n, 0, PGSIZE - n);
+      if(readi(ip, 0, pa, off, n) != n){
+        kfree((void*)pa);
+        pa = 0;
+      }
+    }
+  } else if((pa = (uint64)kalloc()) != 0){
+    // past the end of the file.
+    memset((char*)pa, 0, PGSIZE);
+  }
+  iunlock(ip);
+  if(pa == 0)
+    return -1;
+
+  perm = PTE_U;
+  if(v->prot & (PROT_READ|PROT_WRITE))
+    perm |= PTE_R;
+  if(v->prot & PROT_EXEC)
+    perm |= PTE_X;
+  if((v->prot & PROT_WRITE) && own)
+    perm |= PTE_W;
+  if(scause == 15)
+    perm |= PTE_A | PTE_D;
+  if(mappages(p->pagetable, va, PGSIZE, pa, perm) != 0){
+    kfree((void*)pa);
+    return -1;
+  }
+  return 0;
+}
+
+// Fault in the pages of p's mappings in [va, va+n), for a
+// copy that will be made holding a lock: a spinlock, as into
+// or out of a pipe or a device, which can't sleep to fault
+// pages in as it goes, or an inode's lock, which vmafault()
+// may need itself. write asks for writable pages.
+// Returns 0, or -1 if some page can't be faulted in.
+int
+vmaprefault(struct proc *p, uint64 va, uint64 n, int write)
+{
+  struct vma *v;
+  uint64 a, end;
+  pte_t *pte;
+
+  if(va + n < va)
+    return -1;
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++){
+    if(v->f == 0 || v->end <= va || va + n <= v->start)
+      continue;
+    a = PGROUNDDOWN(va > v->start ? va : v->start);
+    end = va + n < v->end ? va + n : v->end;
+    for(; a < end; a += PGSIZE){
+      pte = walk(p->pagetable, a, 0);
+      if(pte == 0 || (*pte & PTE_V) == 0 || (write && (*pte & PTE_W) == 0))
+        if(vmafault(p, a, write ? 15 : 13) < 0)
+          return -1;
+    }
+  }
+  return 0;
+}
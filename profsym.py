@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Symbolize samples printed by the xv6 `prof` command into
+folded stacks, one line per distinct stack with its count,
+for flamegraph.pl and similar tools:
+
+    ./profsym.py qemu-output.txt > prof.folded
+    flamegraph.pl prof.folded > prof.svg
+
+Kernel addresses are looked up in kernel/kernel, and user
+addresses in user/_<name>, so run it from the top of the
+tree after building.
+"""
+
+import bisect
+import collections
+import os
+import struct
+import sys
+
+def elf_funcs(path):
+    """Return sorted lists (addrs, names) of the FUNC symbols in
+    the ELF64 little-endian file at path."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'\x7fELF' or data[4] != 2:
+        raise ValueError('%s: not a 64-bit ELF file' % path)
+    shoff, = struct.unpack_from('<Q', data, 0x28)
+    shentsize, shnum = struct.unpack_from('<HH', data, 0x3a)
+    sections = []
+    for i in range(shnum):
+        sections.append(struct.unpack_from('<IIQQQQIIQQ', data, shoff + i*shentsize))
+    syms = []
+    for (name, type, flags, addr, off, size, link, info, align, entsize) in sections:
+        if type != 2:   # SHT_SYMTAB
+            continue
+        stroff = sections[link][4]
+        for j in range(size // entsize):
+            st_name, st_info, st_other, st_shndx, st_value, st_size = \
+                struct.unpack_from('<IBBHQQ', data, off + j*entsize)
+            if st_info & 0xf != 2 or st_shndx == 0:  # defined STT_FUNC only
+                continue
+            end = data.index(b'\0', stroff + st_name)
+            syms.append((st_value, data[stroff + st_name:end].decode()))
+    syms.sort()
+    return [a for a, _ in syms], [n for _, n in syms]
+
+_cache = {}
+
+def lookup(path, pc):
+    if path not in _cache:
+        try:
+            _cache[path] = elf_funcs(path)
+        except (OSError, ValueError):
+            _cache[path] = ([], [])
+    addrs, names = _cache[path]
+    i = bisect.bisect_right(addrs, pc) - 1
+    if i < 0:
+        return '0x%x' % pc
+    return names[i]
+
+def main():
+    counts = collections.Counter()
+    for line in (open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin):
+        f = line.split()
+        if len(f) < 6 or f[0] != 'prof':
+            continue
+        cpu, pid, name, mode = f[1], f[2], f[3], f[4]
+        pcs = [int(x, 16) for x in f[5:]]
+        if mode == 'k':
+            path, suffix = 'kernel/kernel', '_[k]'
+        else:
+            path, suffix = os.path.join('user', '_' + name), ''
+        frames = []
+        for i, pc in enumerate(pcs):
+            # return addresses point after the call.
+            frames.append(lookup(path, pc if i == 0 else pc - 1) + suffix)
+        root = name if pid != '0' else 'idle'
+        counts[';'.join([root] + frames[::-1])] += 1
+    for stack, n in sorted(counts.items()):
+        print(stack, n)
+
+if __name__ == '__main__':
+    main()
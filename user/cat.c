@@ -4,11 +4,26 @@
 
 char buf[512];
 
+#define SENDSZ (64*1024)
+
 void
 cat(int fd)
 {
   int n;
 
+  // if fd is a file, let the kernel copy it to stdout
+  // without passing it through buf. sendfile() fails
+  // before copying anything if fd is a pipe or device.
+  if((n = sendfile(1, fd, 0, SENDSZ)) >= 0){
+    while(n > 0)
+      n = sendfile(1, fd, 0, SENDSZ);
+    if(n < 0){
+      fprintf(2, "cat: write error\n");
+      exit(1);
+    }
+    return;
+  }
+
   while((n = read(fd, buf, sizeof(buf))) > 0) {
     if (write(1, buf, n) != n) {
       fprintf(2, "cat: write error\n");
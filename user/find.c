@@ -1,88 +1,287 @@
+// Print the paths of all files named name below path.
+//
+//   find [-P procs] path name
+//
+// Directories are read many entries at a time with getdents(),
+// which also gives each entry's type, so nothing needs to be
+// looked up by path. Each directory is closed before its
+// subdirectories are searched, so neither the stack nor the
+// open files grow much with depth.
+//
+// With -P, a feeder process lists the top of the tree until it
+// has a few subdirectories per worker, and hands them to procs
+// workers through a pipe; their output comes back through
+// another pipe. Each write to that pipe holds whole lines and
+// is at most PIPESIZE bytes, so lines from different workers
+// are never mixed. The order of the output is not defined.
+
 #include "kernel/types.h"
 #include "kernel/stat.h"
-#include "user/user.h"
 #include "kernel/fs.h"
+#include "kernel/param.h"
+#include "user/user.h"
 
-void find(char *path, char *filename);
+#define NDIRENT 64        // entries per getdents()
+#define OUTSZ   512       // PIPESIZE: the most a pipe writes at once
+#define PERPROC 4         // subdirectories wanted per worker
 
-int main(int argc, char *argv[]) {
-    if (argc < 3) {
-        fprintf (2, "需要目录和文件名参数。");
-        exit(1);
-    }
+char *target;
+char path[512];
+
+struct dirstat dbuf[NDIRENT];
+
+char outbuf[OUTSZ];
+int nout;
+int outfd = 1;
+
+void
+flushout(void)
+{
+  if(nout > 0)
+    write(outfd, outbuf, nout);
+  nout = 0;
+}
 
-    find(argv[1], argv[2]);
-    exit(0);
+void
+emit(char *p, int n)
+{
+  if(nout + n + 1 > OUTSZ)
+    flushout();
+  if(n + 1 > OUTSZ){
+    write(outfd, p, n);
+    write(outfd, "\n", 1);
+    return;
+  }
+  memmove(outbuf + nout, p, n);
+  nout += n;
+  outbuf[nout++] = '\n';
 }
 
-/*
-1. 打开指定目录
-2. 搜索目录
-    2.1 遍历
-    2.2 名匹配
-3. 子目录递归进行搜索
-*/
-void find(char *path, char *filename) {
-    // 参数：fd表示打开的目录，de用于存储读取的信息，st用于获取文件类型
-    char buf[512], *p;
-    int fd;
-    struct dirent de;
-    struct stat st;
-
-    // 错误检查
-    if ((fd = open(path, 0)) < 0) {
-        fprintf(2, "无法打开目录 %s\n", path);
-        return;
+// An entry of a directory to print or search, or both,
+// once the directory is closed.
+struct ent {
+  char name[DIRSIZ+1];
+  char match;
+  char dir;
+};
+
+// List the directory path[0..len), printing entries named
+// target and calling subdir for each subdirectory, with the
+// subdirectory's name appended to path, in directory order,
+// so a subdirectory's matches come before those of later
+// entries. Returns -1 if path cannot be read as a directory.
+int
+scan(int len, void (*subdir)(int))
+{
+  struct ent *ents, *e;
+  char *p;
+  int fd, i, n, nent, maxent, match, dir;
+  struct stat st;
+
+  if((fd = open(path, 0)) < 0){
+    fprintf(2, "find: cannot open %s\n", path);
+    return -1;
+  }
+  if(fstat(fd, &st) < 0 || st.type != T_DIR){
+    fprintf(2, "find: %s is not a directory\n", path);
+    close(fd);
+    return -1;
+  }
+  if(len + 1 + DIRSIZ + 1 > sizeof path){
+    fprintf(2, "find: path too long\n");
+    close(fd);
+    return -1;
+  }
+
+  // remember the entries that matter, and act on them only
+  // once the directory is closed.
+  maxent = st.size / sizeof(struct dirent);
+  if((ents = malloc(maxent * sizeof(struct ent) + 1)) == 0){
+    fprintf(2, "find: out of memory\n");
+    close(fd);
+    return -1;
+  }
+  nent = 0;
+  while((n = getdents(fd, dbuf, NDIRENT)) > 0){
+    for(i = 0; i < n; i++){
+      if(strcmp(dbuf[i].name, ".") == 0 || strcmp(dbuf[i].name, "..") == 0)
+        continue;
+      match = strcmp(dbuf[i].name, target) == 0;
+      dir = dbuf[i].type == T_DIR;
+      if((match || dir) && nent < maxent){
+        e = &ents[nent++];
+        strcpy(e->name, dbuf[i].name);
+        e->match = match;
+        e->dir = dir;
+      }
     }
+  }
+  close(fd);
 
-    if ((fstat(fd, &st)) < 0) {
-        fprintf(2, "无法获取目录 %s 的状态\n", path);
-        close(fd);
-        return;
+  p = path + len;
+  *p++ = '/';
+  for(e = ents; e < &ents[nent]; e++){
+    strcpy(p, e->name);
+    if(e->match)
+      emit(path, len + 1 + strlen(p));
+    if(e->dir)
+      subdir(len + 1 + strlen(p));
+  }
+  path[len] = 0;
+  free(ents);
+  return 0;
+}
+
+void
+find(int len)
+{
+  scan(len, find);
+}
+
+// The feeder's queue of subdirectories for the workers.
+char **queue;
+int nqueue, queuesz;
+
+void
+enqueue(int len)
+{
+  if(nqueue == queuesz){
+    queuesz = queuesz ? 2*queuesz : 16;
+    if((queue = realloc(queue, queuesz * sizeof(char*))) == 0){
+      fprintf(2, "find: out of memory\n");
+      exit(1);
     }
+  }
+  if((queue[nqueue] = malloc(len + 1)) == 0){
+    fprintf(2, "find: out of memory\n");
+    exit(1);
+  }
+  strcpy(queue[nqueue++], path);
+}
+
+// List the tree breadth first until there are enough
+// subdirectories to share out, then send each down the
+// work pipe as a MAXPATH-byte record.
+void
+feed(int len, int procs, int workfd)
+{
+  char rec[MAXPATH], **level;
+  int i, n;
 
-    if (st.type != T_DIR) {
-        fprintf(2, "%s 不是一个目录\n", path);
-        close(fd);
-        return;
+  if(scan(len, enqueue) < 0)
+    exit(1);
+  while(nqueue > 0 && nqueue < PERPROC * procs){
+    level = queue;
+    n = nqueue;
+    queue = 0;
+    nqueue = queuesz = 0;
+    for(i = 0; i < n; i++){
+      strcpy(path, level[i]);
+      scan(strlen(path), enqueue);
+      free(level[i]);
     }
+    free(level);
+  }
 
-    if (strlen(path) + 1 + DIRSIZ + 1 > sizeof buf) {
-        fprintf(2, "路径太长\n");
-        close(fd);
-        return;
+  for(i = 0; i < nqueue; i++){
+    strcpy(path, queue[i]);
+    n = strlen(path);
+    if(n >= MAXPATH){
+      find(n);            // too long for a record
+    } else {
+      memset(rec, 0, sizeof rec);
+      memmove(rec, path, n);
+      write(workfd, rec, sizeof rec);
     }
+    free(queue[i]);
+  }
+  free(queue);
+}
 
-    strcpy(buf, path);
-    p = buf + strlen(buf);
-    *p++ = '/';
+// Search each subdirectory read from the work pipe.
+// Every write there is one record, so each read is too.
+void
+work(int workfd)
+{
+  char rec[MAXPATH];
 
-    // 遍历当前目录
-    while (read(fd, &de, sizeof(de))) {
-        // 跳过无效的目录项，只处理实际存在的文件和目录
-        if (de.inum == 0) continue;
+  while(read(workfd, rec, sizeof rec) == sizeof rec){
+    rec[MAXPATH-1] = 0;
+    strcpy(path, rec);
+    find(strlen(path));
+  }
+}
 
-        memmove(p, de.name, DIRSIZ);
-        p[DIRSIZ] = 0;
+void
+parallel(int len, int procs)
+{
+  int wp[2], out[2];
+  int i, n, pid;
 
-        if (stat(buf, &st) < 0) {
-            fprintf(2, "无法获取文件 %s 的状态\n", buf);
-            continue;
-        }
+  if(pipe(wp) < 0 || pipe(out) < 0){
+    fprintf(2, "find: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i <= procs; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "find: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(out[0]);
+      outfd = out[1];
+      if(i == 0){
+        close(wp[0]);
+        feed(len, procs, wp[1]);
+      } else {
+        close(wp[1]);
+        work(wp[0]);
+      }
+      flushout();
+      exit(0);
+    }
+  }
+  close(wp[0]);
+  close(wp[1]);
+  close(out[1]);
 
-        // 跳过当前目录和父目录
-        if (strcmp(de.name, ".") == 0 || strcmp(de.name, "..") == 0) continue;
+  // the feeder must not block on a full output pipe
+  // while the workers wait for work, so keep reading.
+  while((n = read(out[0], outbuf, sizeof outbuf)) > 0)
+    write(1, outbuf, n);
+  close(out[0]);
+  while(wait(0) >= 0)
+    ;
+}
 
-        // 文件名匹配
-        if (strcmp(de.name, filename) == 0) {
-            printf("%s\n", buf);
-        }
+int
+main(int argc, char *argv[])
+{
+  int procs = 0, len;
 
-        // 递归搜索子目录
-        if (st.type == T_DIR) {
-            find(buf, filename);
-        }
-    }
+  if(argc == 5 && strcmp(argv[1], "-P") == 0){
+    procs = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+    if(procs <= 0)
+      argc = 0;
+  }
+  if(argc != 3){
+    fprintf(2, "usage: find [-P procs] path name\n");
+    exit(1);
+  }
+  target = argv[2];
+  if((len = strlen(argv[1])) + 1 + DIRSIZ + 1 > sizeof path){
+    fprintf(2, "find: path too long\n");
+    exit(1);
+  }
+  strcpy(path, argv[1]);
 
-    close(fd);
-}
\ No newline at end of file
+  if(procs == 0){
+    find(len);
+    flushout();
+  } else {
+    parallel(len, procs);
+  }
+  exit(0);
+}
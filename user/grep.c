@@ -1,37 +1,235 @@
 // Simple grep.  Only supports ^ . * $ operators.
+//
+// The pattern is compiled once. A pattern of plain characters
+// is found with a Boyer-Moore-Horspool search; other patterns
+// run as a DFA built lazily from the pattern's NFA. Patterns
+// too long for the NFA's bit sets use the Kernighan & Pike
+// matcher below.
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
 #include "user/user.h"
 
-char buf[1024];
+struct lwriter out;
 int match(char*, char*);
 
+#define NELEM 63          // most pattern elements for the NFA
+#define NDFA 64           // DFA states cached at once
+
+enum { SLOW, LITERAL, AUTOMATON };
+
+struct pattern {
+  char *re;               // as given, for SLOW
+  int kind;
+  int bol, eol;           // anchored by ^ or $
+
+  // LITERAL: the characters and the Horspool skip table.
+  char lit[NELEM];
+  int nlit;
+  int skip[256];
+
+  // AUTOMATON: NFA state i (bit i) means the first i
+  // elements have matched. cmask[c] has bit i if element i
+  // matches character c; star has bit i if element i is
+  // starred, and so may match again or not at all.
+  uint64 cmask[256];
+  uint64 star;
+  uint64 start;           // states before any input
+  uint64 accept;          // all elements matched
+} pat;
+
+// the DFA: sets of NFA states, and the transitions
+// between them found so far (-1 if not yet).
+uint64 dset[NDFA];
+short dnext[NDFA][256];
+int ndfa;
+
+// x plus every state reachable from x by skipping
+// starred elements.
+uint64
+closure(uint64 x)
+{
+  uint64 y;
+
+  while((y = x | ((x & pat.star) << 1)) != x)
+    x = y;
+  return x;
+}
+
 void
-grep(char *pattern, int fd)
+compile(char *re)
 {
-  int n, m;
-  char *p, *q;
-
-  m = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
-    m += n;
-    buf[m] = '\0';
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      if(match(pattern, p)){
-        *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
+  int i, c, n = 0, plain = 1;
+
+  memset(&pat, 0, sizeof(pat));
+  pat.re = re;
+  if(re[0] == '^'){
+    pat.bol = 1;
+    re++;
+  }
+  for(i = 0; re[i]; n++){
+    if(re[i] == '$' && re[i+1] == '\0'){
+      pat.eol = 1;
+      break;
     }
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
+    if(n == NELEM){
+      pat.kind = SLOW;
+      return;
     }
+    c = (uchar)re[i];
+    pat.lit[n] = c;
+    if(c == '.'){
+      for(c = 1; c < 256; c++)
+        pat.cmask[c] |= 1L << n;
+      plain = 0;
+    } else
+      pat.cmask[c] |= 1L << n;
+    if(re[i+1] == '*'){
+      pat.star |= 1L << n;
+      plain = 0;
+      i += 2;
+    } else
+      i++;
+  }
+
+  if(plain){
+    pat.kind = LITERAL;
+    pat.nlit = n;
+    for(c = 0; c < 256; c++)
+      pat.skip[c] = n;
+    for(i = 0; i < n - 1; i++)
+      pat.skip[(uchar)pat.lit[i]] = n - 1 - i;
+    return;
+  }
+
+  pat.kind = AUTOMATON;
+  pat.start = closure(1);
+  pat.accept = 1L << n;
+  ndfa = 0;
+}
+
+// the DFA state for NFA states s, or -1 if the cache is full.
+int
+dfastate(uint64 s)
+{
+  int i;
+
+  for(i = 0; i < ndfa; i++)
+    if(dset[i] == s)
+      return i;
+  if(ndfa == NDFA)
+    return -1;
+  dset[ndfa] = s;
+  memset(dnext[ndfa], 0xff, sizeof(dnext[ndfa]));
+  return ndfa++;
+}
+
+// the DFA state after state i reads character c.
+int
+dfanext(int i, int c)
+{
+  uint64 s, m;
+  int j;
+
+  m = dset[i] & pat.cmask[c];
+  s = closure(((m & ~pat.star) << 1) | (m & pat.star));
+  if(!pat.bol)
+    s |= pat.start;
+  if((j = dfastate(s)) < 0){
+    // forget the DFA built so far, and start again.
+    ndfa = 0;
+    return dfastate(s);
+  }
+  dnext[i][c] = j;
+  return j;
+}
+
+int
+automaton(char *text, int n)
+{
+  int i, k, c;
+
+  k = dfastate(pat.start);
+  if(k < 0){
+    ndfa = 0;
+    k = dfastate(pat.start);
+  }
+  for(i = 0; i < n; i++){
+    if(!pat.eol && (dset[k] & pat.accept))
+      return 1;
+    if(dset[k] == 0)
+      return 0;
+    c = (uchar)text[i];
+    if(dnext[k][c] >= 0)
+      k = dnext[k][c];
+    else
+      k = dfanext(k, c);
+  }
+  return (dset[k] & pat.accept) != 0;
+}
+
+// Horspool: compare the pattern's last character first,
+// and on a mismatch shift by how far that text character
+// is from the end of the pattern.
+int
+literal(char *text, int n)
+{
+  int i, j, m = pat.nlit;
+
+  if(pat.bol && pat.eol)
+    return n == m && memcmp(text, pat.lit, m) == 0;
+  if(pat.bol)
+    return n >= m && memcmp(text, pat.lit, m) == 0;
+  if(pat.eol)
+    return n >= m && memcmp(text + n - m, pat.lit, m) == 0;
+  if(m == 0)
+    return 1;
+  for(i = 0; i <= n - m; i += pat.skip[(uchar)text[i + m - 1]]){
+    for(j = m - 1; j >= 0 && text[i + j] == pat.lit[j]; j--)
+      ;
+    if(j < 0)
+      return 1;
+  }
+  return 0;
+}
+
+// does the n-character line at text, NUL-terminated, match?
+int
+matchline(char *text, int n)
+{
+  switch(pat.kind){
+  case LITERAL:
+    return literal(text, n);
+  case AUTOMATON:
+    return automaton(text, n);
+  }
+  return match(pat.re, text);
+}
+
+void
+grep(char *pattern, int fd)
+{
+  struct lreader lr;
+  int n, nl;
+  char *p, c;
+
+  if(lrinit(&lr, fd) < 0){
+    fprintf(2, "grep: out of memory\n");
+    exit(1);
+  }
+  while((p = lrline(&lr, &n)) != 0){
+    // match the line without its newline, NUL-terminated.
+    nl = p[n-1] == '\n';
+    c = p[n-nl];
+    p[n-nl] = 0;
+    if(matchline(p, n-nl)){
+      p[n-nl] = c;
+      lwwrite(&out, p, n);
+    } else
+      p[n-nl] = c;
   }
+  lrfree(&lr);
 }
 
 int
@@ -45,20 +243,25 @@ main(int argc, char *argv[])
     exit(1);
   }
   pattern = argv[1];
+  compile(pattern);
+  lwinit(&out, 1);
 
   if(argc <= 2){
     grep(pattern, 0);
+    lwflush(&out);
     exit(0);
   }
 
   for(i = 2; i < argc; i++){
     if((fd = open(argv[i], O_RDONLY)) < 0){
+      lwflush(&out);
       printf("grep: cannot open %s\n", argv[i]);
       exit(1);
     }
     grep(pattern, fd);
     close(fd);
   }
+  lwflush(&out);
   exit(0);
 }
 
@@ -0,0 +1,159 @@
+// Time grep over a few MB of log-like text, with a literal,
+// an anchored literal and a couple of regular expressions.
+//
+//   grepbench [passes]
+//
+// xv6 files are at most MAXFILE blocks, so grep reads one
+// such file passes times over.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+#define FILE "grepbench.txt"
+#define OUT "grepbench.out"
+
+char *levels[] = { "INFO", "INFO", "INFO", "WARN", "ERROR" };
+char *words[] = { "open", "read", "write", "close", "stat", "sync", "fork" };
+
+char *patterns[] = {
+  "timeout",            // literal, rare
+  "^ERROR",             // anchored literal
+  "fork.*took 9",       // regex
+  "took [0-9]*9 ms$",   // regex, the brackets taken literally
+};
+
+static uint64 seed = 1;
+
+static uint
+rnd(void)
+{
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return seed >> 33;
+}
+
+// write x in decimal at s, and return its length.
+static int
+putnum(char *s, uint x)
+{
+  char tmp[16];
+  int i = 0, n = 0;
+
+  do
+    tmp[i++] = '0' + x % 10;
+  while((x /= 10) != 0);
+  while(i > 0)
+    s[n++] = tmp[--i];
+  return n;
+}
+
+static uint64
+nsecs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(&ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// fill FILE with lines like
+// 123456 INFO pid 17: write of 512 bytes took 12 ms
+// and return its size.
+int
+mkfile(void)
+{
+  char line[128];
+  int fd, n, size = 0;
+
+  if((fd = open(FILE, O_CREATE|O_WRONLY|O_TRUNC)) < 0){
+    fprintf(2, "grepbench: cannot create %s\n", FILE);
+    exit(1);
+  }
+  for(;;){
+    n = 0;
+    // build the line by hand; printf would write it
+    // in pieces.
+    n += putnum(line + n, rnd() % 1000000);
+    line[n++] = ' ';
+    strcpy(line + n, levels[rnd() % 5]);
+    n += strlen(line + n);
+    strcpy(line + n, " pid ");
+    n += 5;
+    n += putnum(line + n, rnd() % 64);
+    strcpy(line + n, ": ");
+    n += 2;
+    strcpy(line + n, words[rnd() % 7]);
+    n += strlen(line + n);
+    strcpy(line + n, " of ");
+    n += 4;
+    n += putnum(line + n, rnd() % 4096);
+    strcpy(line + n, " bytes took ");
+    n += 12;
+    n += putnum(line + n, rnd() % 100);
+    strcpy(line + n, " ms\n");
+    n += 4;
+    if(size + n > MAXFILE*BSIZE)
+      break;
+    if(write(fd, line, n) != n){
+      fprintf(2, "grepbench: write failed\n");
+      exit(1);
+    }
+    size += n;
+  }
+  close(fd);
+  return size;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *args[MAXARG];
+  int i, k, pid, st, size, passes = 16;
+  uint64 t0, ns;
+
+  if(argc > 1)
+    passes = atoi(argv[1]);
+  if(passes <= 0 || passes > MAXARG - 3){
+    fprintf(2, "usage: grepbench [passes]\n");
+    exit(1);
+  }
+
+  size = mkfile();
+  printf("%d KB file, %d passes\n", size / 1024, passes);
+
+  for(i = 0; i < sizeof(patterns)/sizeof(patterns[0]); i++){
+    args[0] = "grep";
+    args[1] = patterns[i];
+    for(k = 0; k < passes; k++)
+      args[2 + k] = FILE;
+    args[2 + passes] = 0;
+
+    t0 = nsecs();
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "grepbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(1);
+      if(open(OUT, O_CREATE|O_WRONLY|O_TRUNC) != 1)
+        exit(1);
+      exec("grep", args);
+      exit(1);
+    }
+    if(wait(&st) != pid || st != 0){
+      fprintf(2, "grepbench: grep %s failed\n", patterns[i]);
+      exit(1);
+    }
+    ns = nsecs() - t0;
+    printf("%s: %ld ms", patterns[i], ns / 1000000);
+    if(ns >= 1000)
+      printf(", %ld KB/s", (uint64)size * passes * 1000000 / 1024 / (ns / 1000));
+    printf("\n");
+  }
+  unlink(FILE);
+  unlink(OUT);
+  exit(0);
+}
@@ -0,0 +1,126 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/uio.h"
+#include "user/user.h"
+
+// Line-at-a-time input and batched output, for programs
+// like grep and wc that stream through large files.
+//
+// A reader fills one large page-aligned buffer with as few
+// read()s as it can, and hands out lines that point into it.
+// Only when the buffer's end is reached is the unfinished
+// line at its end moved to the front, so the buffer works as
+// a ring that copies at most one partial line per refill.
+//
+// A writer gathers output and writes it a buffer at a time,
+// or a line at a time if it goes to the console.
+
+// Start reading fd. Returns 0, or -1 if out of memory.
+int
+lrinit(struct lreader *lr, int fd)
+{
+  // one spare byte after the buffer; see lrline().
+  if((lr->mem = malloc(LRBUFSZ + PGSIZE + 1)) == 0)
+    return -1;
+  lr->buf = (char*)PGROUNDUP((uint64)lr->mem);
+  lr->fd = fd;
+  lr->r = lr->w = 0;
+  lr->eof = 0;
+  lr->err = 0;
+  return 0;
+}
+
+void
+lrfree(struct lreader *lr)
+{
+  free(lr->mem);
+  lr->mem = lr->buf = 0;
+}
+
+// Return the next line, including its newline, and set *n
+// to its length; or return 0 at end of input. The last line
+// may lack a newline, and a line longer than LRBUFSZ comes
+// back in pieces. The line stays valid until the next call.
+// The caller may overwrite the byte after the line, e.g. to
+// NUL-terminate it, as long as it puts it back.
+char*
+lrline(struct lreader *lr, int *n)
+{
+  char *p, *q;
+  int cc;
+
+  for(;;){
+    p = lr->buf + lr->r;
+    if((q = memchr(p, '\n', lr->w - lr->r)) != 0){
+      *n = q + 1 - p;
+      lr->r += *n;
+      return p;
+    }
+    if(lr->eof || (lr->w == LRBUFSZ && lr->r == 0)){
+      // the end, or a line that fills the buffer.
+      if(lr->r == lr->w)
+        return 0;
+      *n = lr->w - lr->r;
+      lr->r = lr->w;
+      return p;
+    }
+    if(lr->r == lr->w){
+      lr->r = lr->w = 0;
+    } else if(lr->w == LRBUFSZ){
+      memmove(lr->buf, p, lr->w - lr->r);
+      lr->w -= lr->r;
+      lr->r = 0;
+    }
+    cc = read(lr->fd, lr->buf + lr->w, LRBUFSZ - lr->w);
+    if(cc <= 0){
+      lr->eof = 1;
+      lr->err = cc < 0;
+    } else
+      lr->w += cc;
+  }
+}
+
+// Start writing to fd.
+void
+lwinit(struct lwriter *lw, int fd)
+{
+  struct stat st;
+
+  lw->fd = fd;
+  lw->n = 0;
+  lw->linebuf = fstat(fd, &st) == 0 && st.type == T_DEVICE;
+}
+
+void
+lwflush(struct lwriter *lw)
+{
+  if(lw->n > 0)
+    write(lw->fd, lw->buf, lw->n);
+  lw->n = 0;
+}
+
+// Write n bytes from p, eventually.
+void
+lwwrite(struct lwriter *lw, char *p, int n)
+{
+  struct iovec iov[2];
+
+  if(n > LWBUFSZ){
+    // too big to buffer: write it after what
+    // is buffered, in one system call.
+    iov[0].iov_base = lw->buf;
+    iov[0].iov_len = lw->n;
+    iov[1].iov_base = p;
+    iov[1].iov_len = n;
+    writev(lw->fd, iov, 2);
+    lw->n = 0;
+    return;
+  }
+  if(lw->n + n > LWBUFSZ)
+    lwflush(lw);
+  memmove(lw->buf + lw->n, p, n);
+  lw->n += n;
+  if(lw->linebuf && n > 0 && p[n-1] == '\n')
+    lwflush(lw);
+}
@@ -0,0 +1,92 @@
+// Time malloc and free under a random mix of sizes, mostly
+// small with some large, and report how much heap they took
+// for the most bytes that were live at once.
+//
+//   mallocbench [ops]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define NSLOT 2000
+
+char *slot[NSLOT];
+uint slotsz[NSLOT];
+
+static uint64 seed = 1;
+
+static uint
+rnd(void)
+{
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return seed >> 33;
+}
+
+// mostly small, like the strings and nodes of sh or find.
+static uint
+rndsize(void)
+{
+  uint r = rnd() % 100;
+
+  if(r < 70)
+    return 1 + rnd() % 64;
+  if(r < 95)
+    return 1 + rnd() % 1024;
+  return 1 + rnd() % 32768;
+}
+
+static uint64
+nsecs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(&ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ops = 200000, i, j;
+  uint64 live = 0, peak = 0, t0, ns;
+  char *heap0, *heap1;
+
+  if(argc > 1)
+    ops = atoi(argv[1]);
+  if(ops <= 0){
+    fprintf(2, "usage: mallocbench [ops]\n");
+    exit(1);
+  }
+
+  heap0 = sbrk(0);
+  t0 = nsecs();
+  for(i = 0; i < ops; i++){
+    j = rnd() % NSLOT;
+    if(slot[j]){
+      free(slot[j]);
+      slot[j] = 0;
+      live -= slotsz[j];
+    } else {
+      slotsz[j] = rndsize();
+      if((slot[j] = malloc(slotsz[j])) == 0){
+        fprintf(2, "mallocbench: out of memory after %d ops\n", i);
+        exit(1);
+      }
+      slot[j][0] = 1;
+      live += slotsz[j];
+      if(live > peak)
+        peak = live;
+    }
+  }
+  ns = nsecs() - t0;
+  heap1 = sbrk(0);
+
+  printf("%d ops in %ld us", ops, ns / 1000);
+  if(ns > 0)
+    printf(", %ld ops/s", (uint64)ops * 1000000 / (ns / 1000 + 1));
+  printf("\n");
+  printf("peak live %ld KB, heap %ld KB", peak / 1024, (uint64)(heap1 - heap0) / 1024);
+  if(peak > 0)
+    printf(", %ld%% overhead", ((uint64)(heap1 - heap0) - peak) * 100 / peak);
+  printf("\n");
+  exit(0);
+}
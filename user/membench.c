@@ -0,0 +1,95 @@
+// Measure the kernel's memset and memmove through the paths
+// that lean on them most: filling pages as sbrk allocates
+// them, and copying cached file blocks out to read().
+//
+//   membench [mb]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+#define MB (1024*1024)
+
+static uint64
+nsecs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(&ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+report(char *what, uint64 bytes, uint64 ns)
+{
+  printf("%s: %ld MB in %ld us", what, bytes / MB, ns / 1000);
+  if(ns > 0)
+    printf(", %ld MB/s", bytes * 1000 / ns * 1000000 / MB);
+  printf("\n");
+}
+
+// grow and shrink the heap by chunk bytes, until mb MB
+// of pages have been zeroed by the kernel, and freed.
+void
+pagefill(int mb)
+{
+  int chunk = MB, i;
+  uint64 t0;
+
+  t0 = nsecs();
+  for(i = 0; i < mb; i++){
+    if(sbrk(chunk) == (char*)-1){
+      fprintf(2, "membench: sbrk failed\n");
+      exit(1);
+    }
+    sbrk(-chunk);
+  }
+  report("page fill", (uint64)mb * MB, nsecs() - t0);
+}
+
+// read a small file, which stays in the buffer cache,
+// over and over, a block at a time.
+void
+blockcopy(int mb)
+{
+  static char buf[BSIZE];
+  int fd, i, n, nblocks = 8;
+  uint64 t0, total = 0;
+
+  fd = open("membench.tmp", O_CREATE|O_RDWR|O_TRUNC);
+  if(fd < 0){
+    fprintf(2, "membench: cannot create membench.tmp\n");
+    exit(1);
+  }
+  for(i = 0; i < nblocks; i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  t0 = nsecs();
+  while(total < (uint64)mb * MB){
+    fd = open("membench.tmp", O_RDONLY);
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      total += n;
+    close(fd);
+  }
+  report("block copy", total, nsecs() - t0);
+  unlink("membench.tmp");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 64;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  if(mb <= 0){
+    fprintf(2, "usage: membench [mb]\n");
+    exit(1);
+  }
+
+  pagefill(mb);
+  blockcopy(mb);
+  exit(0);
+}
@@ -0,0 +1,50 @@
+// Run a command and report the cycles and instructions it
+// and its children took, and their ratio (IPC).
+//
+//   perfstat command args...
+
+#include "kernel/types.h"
+#include "kernel/perf.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct perfcount before, after;
+  uint64 cycles, instret, ipc;
+  int pid, xstatus;
+
+  if(argc < 2){
+    fprintf(2, "usage: perfstat command args...\n");
+    exit(1);
+  }
+
+  if(perf(&before) < 0){
+    fprintf(2, "perfstat: perf failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "perfstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv+1);
+    fprintf(2, "perfstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(&xstatus);
+  perf(&after);
+
+  cycles = after.ccycles - before.ccycles;
+  instret = after.cinstret - before.cinstret;
+  printf("%s: exit status %d\n", argv[1], xstatus);
+  printf("%ld cycles\n", cycles);
+  printf("%ld instructions\n", instret);
+  if(cycles > 0){
+    // two decimal places.
+    ipc = instret * 100 / cycles;
+    printf("%ld.%ld%ld IPC\n", ipc / 100, ipc / 10 % 10, ipc % 10);
+  }
+  exit(0);
+}
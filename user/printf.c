@@ -6,14 +6,63 @@
 
 static char digits[] = "0123456789ABCDEF";
 
+// Output is collected in a buffer and written with one
+// write() per call, or less often for fd 1: it stays
+// buffered until a newline if fd 1 is the console, and
+// until the buffer fills otherwise (a pipe or file).
+// fork(), exec(), exit() and gets() flush it first,
+// as does fflush(1).
+
+#define OBUFSZ 512
+
+#define UNKNOWN 0
+#define LINEBUF 1
+#define FULLBUF 2
+
+struct obuf {
+  int fd;
+  int n;
+  int nl;       // a newline is waiting in buf
+  char buf[OBUFSZ];
+};
+
+static struct obuf out = { 1 };
+static int outmode = UNKNOWN;
+
+static void
+flush(struct obuf *b)
+{
+  if(b->n > 0)
+    write(b->fd, b->buf, b->n);
+  b->n = 0;
+  b->nl = 0;
+}
+
+static void
+flushout(void)
+{
+  flush(&out);
+}
+
+void
+fflush(int fd)
+{
+  if(fd == 1)
+    flush(&out);
+}
+
 static void
-putc(int fd, char c)
+putc(struct obuf *b, char c)
 {
-  write(fd, &c, 1);
+  if(b->n == OBUFSZ)
+    flush(b);
+  b->buf[b->n++] = c;
+  if(c == '\n')
+    b->nl = 1;
 }
 
 static void
-printint(int fd, int xx, int base, int sgn)
+printint(struct obuf *b, int xx, int base, int sgn)
 {
   char buf[16];
   int i, neg;
@@ -35,16 +84,16 @@ printint(int fd, int xx, int base, int sgn)
     buf[i++] = '-';
 
   while(--i >= 0)
-    putc(fd, buf[i]);
+    putc(b, buf[i]);
 }
 
 static void
-printptr(int fd, uint64 x) {
+printptr(struct obuf *b, uint64 x) {
   int i;
-  putc(fd, '0');
-  putc(fd, 'x');
+  putc(b, '0');
+  putc(b, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    putc(fd, digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(b, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the given fd. Only understands %d, %x, %p, %s.
@@ -53,6 +102,24 @@ vprintf(int fd, const char *fmt, va_list ap)
 {
   char *s;
   int c0, c1, c2, i, state;
+  struct obuf local, *b;
+  struct stat st;
+
+  if(fd == 1){
+    b = &out;
+    if(outmode == UNKNOWN){
+      if(fstat(1, &st) == 0 && st.type == T_DEVICE)
+        outmode = LINEBUF;
+      else
+        outmode = FULLBUF;
+      _flushout = flushout;
+    }
+  } else {
+    b = &local;
+    b->fd = fd;
+    b->n = 0;
+    b->nl = 0;
+  }
 
   state = 0;
   for(i = 0; fmt[i]; i++){
@@ -61,81 +128,84 @@ vprintf(int fd, const char *fmt, va_list ap)
       if(c0 == '%'){
         state = '%';
       } else {
-        putc(fd, c0);
+        putc(b, c0);
       }
     } else if(state == '%'){
       c1 = c2 = 0;
       if(c0) c1 = fmt[i+1] & 0xff;
       if(c1) c2 = fmt[i+2] & 0xff;
       if(c0 == 'd'){
-        printint(fd, va_arg(ap, int), 10, 1);
+        printint(b, va_arg(ap, int), 10, 1);
       } else if(c0 == 'l' && c1 == 'd'){
-        printint(fd, va_arg(ap, uint64), 10, 1);
+        printint(b, va_arg(ap, uint64), 10, 1);
         i += 1;
       } else if(c0 == 'l' && c1 == 'l' && c2 == 'd'){
-        printint(fd, va_arg(ap, uint64), 10, 1);
+        printint(b, va_arg(ap, uint64), 10, 1);
         i += 2;
       } else if(c0 == 'u'){
-        printint(fd, va_arg(ap, int), 10, 0);
+        printint(b, va_arg(ap, int), 10, 0);
       } else if(c0 == 'l' && c1 == 'u'){
-        printint(fd, va_arg(ap, uint64), 10, 0);
+        printint(b, va_arg(ap, uint64), 10, 0);
         i += 1;
       } else if(c0 == 'l' && c1 == 'l' && c2 == 'u'){
-        printint(fd, va_arg(ap, uint64), 10, 0);
+        printint(b, va_arg(ap, uint64), 10, 0);
         i += 2;
       } else if(c0 == 'x'){
-        printint(fd, va_arg(ap, int), 16, 0);
+        printint(b, va_arg(ap, int), 16, 0);
       } else if(c0 == 'l' && c1 == 'x'){
-        printint(fd, va_arg(ap, uint64), 16, 0);
+        printint(b, va_arg(ap, uint64), 16, 0);
         i += 1;
       } else if(c0 == 'l' && c1 == 'l' && c2 == 'x'){
-        printint(fd, va_arg(ap, uint64), 16, 0);
+        printint(b, va_arg(ap, uint64), 16, 0);
         i += 2;
       } else if(c0 == 'p'){
-        printptr(fd, va_arg(ap, uint64));
+        printptr(b, va_arg(ap, uint64));
       } else if(c0 == 's'){
         if((s = va_arg(ap, char*)) == 0)
           s = "(null)";
         for(; *s; s++)
-          putc(fd, *s);
+          putc(b, *s);
       } else if(c0 == '%'){
-        putc(fd, '%');
+        putc(b, '%');
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c0);
+        putc(b, '%');
+        putc(b, c0);
       }
 
 #if 0
       if(c == 'd'){
-        printint(fd, va_arg(ap, int), 10, 1);
+        printint(b, va_arg(ap, int), 10, 1);
       } else if(c == 'l') {
-        printint(fd, va_arg(ap, uint64), 10, 0);
+        printint(b, va_arg(ap, uint64), 10, 0);
       } else if(c == 'x') {
-        printint(fd, va_arg(ap, int), 16, 0);
+        printint(b, va_arg(ap, int), 16, 0);
       } else if(c == 'p') {
-        printptr(fd, va_arg(ap, uint64));
+        printptr(b, va_arg(ap, uint64));
       } else if(c == 's'){
         s = va_arg(ap, char*);
         if(s == 0)
           s = "(null)";
         while(*s != 0){
-          putc(fd, *s);
+          putc(b, *s);
           s++;
         }
       } else if(c == 'c'){
-        putc(fd, va_arg(ap, uint));
+        putc(b, va_arg(ap, uint));
       } else if(c == '%'){
-        putc(fd, c);
+        putc(b, c);
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
+        putc(b, '%');
+        putc(b, c);
       }
 #endif
       state = 0;
     }
   }
+
+  if(b != &out || (outmode == LINEBUF && b->nl))
+    flush(b);
 }
 
 void
@@ -0,0 +1,60 @@
+// Profile a command with the kernel's sampling profiler,
+// and print the samples, one per line:
+//
+//   prof <cpu> <pid> <name> <u|k> <pc> <return addresses...>
+//
+// profsym.py on the host turns them into folded stacks.
+//
+//   prof command [args...]
+
+#include "kernel/types.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NBUF 32
+
+struct profsample buf[NBUF];
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, pid, total = 0;
+  struct profsample *s;
+
+  if(argc < 2){
+    fprintf(2, "usage: prof command [args...]\n");
+    exit(1);
+  }
+
+  if(prof(1) < 0){
+    fprintf(2, "prof: cannot start profiler\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    prof(0);
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv+1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  prof(0);
+
+  while((n = profread(buf, NBUF)) > 0){
+    for(i = 0; i < n; i++){
+      s = &buf[i];
+      printf("prof %d %d %s %s", s->cpu, s->pid,
+             s->pid ? s->name : "-", s->user ? "u" : "k");
+      for(j = 0; j < PROFDEPTH && s->pc[j]; j++)
+        printf(" %lx", s->pc[j]);
+      printf("\n");
+    }
+    total += n;
+  }
+  fprintf(2, "prof: %d samples\n", total);
+  exit(0);
+}
@@ -0,0 +1,123 @@
+// Trace the system calls a command makes, and those of
+// the children it forks, printing one line per call:
+//
+//   pid: name(arg0, arg1, arg2) = ret <duration>
+//
+// durations are in r_time() units of 100 ns.
+//
+//   strace [-m mask] command [args...]
+//
+// mask selects system calls, 1<<SYS_xxx, in decimal or in
+// hex with a leading 0x; the default is all.
+
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+#include "user/sysnames.h"
+
+#define NBUF 16
+
+struct tracerec buf[NBUF];
+
+// print the records read so far. returns -1 once every
+// traced process has exited and all have been printed.
+int
+show(void)
+{
+  int i, n;
+  struct tracerec *t;
+
+  while((n = traceread(buf, NBUF)) > 0){
+    for(i = 0; i < n; i++){
+      t = &buf[i];
+      if(t->num == SYS_exit){
+        printf("%d: exit(%d)\n", t->pid, (int)t->args[0]);
+        continue;
+      }
+      printf("%d: %s(0x%lx, 0x%lx, 0x%lx) = %d <%ld>\n", t->pid,
+             t->num < NSYS && sysnames[t->num] ? sysnames[t->num] : "?",
+             t->args[0], t->args[1], t->args[2], (int)t->ret, t->dur);
+    }
+  }
+  return n;
+}
+
+// parse a decimal or 0x hex mask into *mask.
+// returns 0, or -1 if s isn't a number.
+int
+parsemask(char *s, uint64 *mask)
+{
+  uint64 m = 0;
+  int base = 10, d;
+
+  if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X')){
+    base = 16;
+    s += 2;
+  }
+  if(*s == 0)
+    return -1;
+  for(; *s; s++){
+    if(*s >= '0' && *s <= '9')
+      d = *s - '0';
+    else if(base == 16 && *s >= 'a' && *s <= 'f')
+      d = *s - 'a' + 10;
+    else if(base == 16 && *s >= 'A' && *s <= 'F')
+      d = *s - 'A' + 10;
+    else
+      return -1;
+    m = m * base + d;
+  }
+  *mask = m;
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 mask = ~0L;
+  int pid, fds[2];
+  char c;
+
+  if(argc > 2 && strcmp(argv[1], "-m") == 0){
+    if(parsemask(argv[2], &mask) < 0){
+      fprintf(2, "strace: bad mask %s\n", argv[2]);
+      exit(1);
+    }
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc < 2){
+    fprintf(2, "usage: strace [-m mask] command [args...]\n");
+    exit(1);
+  }
+
+  // the child waits on fds until it is traced.
+  if(pipe(fds) < 0){
+    fprintf(2, "strace: pipe failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "strace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[1]);
+    read(fds[0], &c, 1);
+    close(fds[0]);
+    exec(argv[1], argv+1);
+    fprintf(2, "strace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  close(fds[0]);
+  if(trace(pid, mask | (1L << SYS_exit)) < 0)
+    fprintf(2, "strace: trace failed\n");
+  close(fds[1]);
+
+  // the kernel doesn't block readers, so poll.
+  while(show() == 0)
+    sleep(1);
+  wait(0);
+  exit(0);
+}
@@ -0,0 +1,146 @@
+// Compare ulib's string routines with plain byte loops,
+// on inputs from 1 KB to 1 MB. Prints MB/s for each.
+//
+//   strbench [mb]
+//
+// mb is how much data each measurement passes over.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define MB (1024*1024)
+
+static uint64
+nsecs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(&ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// the byte-at-a-time routines ulib used to have.
+// noinline, so that the compiler cannot see through them.
+
+__attribute__((noinline)) static void
+bmemset(char *d, int c, uint n)
+{
+  while(n-- > 0)
+    *d++ = c;
+}
+
+__attribute__((noinline)) static void
+bmemmove(char *d, const char *s, uint n)
+{
+  while(n-- > 0)
+    *d++ = *s++;
+}
+
+__attribute__((noinline)) static int
+bmemcmp(const char *p, const char *q, uint n)
+{
+  for(; n > 0; n--, p++, q++)
+    if(*p != *q)
+      return *p - *q;
+  return 0;
+}
+
+__attribute__((noinline)) static uint
+bstrlen(const char *s)
+{
+  uint n;
+
+  for(n = 0; s[n]; n++)
+    ;
+  return n;
+}
+
+__attribute__((noinline)) static char*
+bstrchr(const char *s, char c)
+{
+  for(; *s; s++)
+    if(*s == c)
+      return (char*)s;
+  return 0;
+}
+
+enum { MEMSET, MEMMOVE, MEMCMP, STRLEN, STRCHR, NOP };
+char *opname[] = { "memset", "memmove", "memcmp", "strlen", "strchr" };
+
+char *a, *b;
+volatile uint64 sink;
+
+// run op over n bytes, with ulib's version or the byte loop.
+static void
+run(int op, int lib, uint n)
+{
+  switch(op){
+  case MEMSET:
+    if(lib) memset(a, 'x', n); else bmemset(a, 'x', n);
+    break;
+  case MEMMOVE:
+    if(lib) memmove(b, a, n); else bmemmove(b, a, n);
+    break;
+  case MEMCMP:
+    sink += lib ? memcmp(a, b, n) : bmemcmp(a, b, n);
+    break;
+  case STRLEN:
+    sink += lib ? strlen(a) : bstrlen(a);
+    break;
+  case STRCHR:
+    sink += (uint64)(lib ? strchr(a, '\n') : bstrchr(a, '\n'));
+    break;
+  }
+}
+
+// MB/s for op on n bytes, repeated to cover total bytes.
+static uint64
+rate(int op, int lib, uint n, uint64 total)
+{
+  uint64 i, reps = total / n, t0, ns;
+
+  // a string of n-1 'x's, the same in a and b.
+  memset(a, 'x', n);
+  memset(b, 'x', n);
+  a[n-1] = b[n-1] = 0;
+
+  t0 = nsecs();
+  for(i = 0; i < reps; i++)
+    run(op, lib, n);
+  ns = nsecs() - t0;
+  if(ns == 0)
+    return 0;
+  return reps * n * 1000 / ns * 1000000 / MB;
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 total;
+  uint n;
+  int op, mb = 16;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  if(mb <= 0){
+    fprintf(2, "usage: strbench [mb]\n");
+    exit(1);
+  }
+  total = (uint64)mb * MB;
+
+  a = malloc(MB);
+  b = malloc(MB);
+  if(a == 0 || b == 0){
+    fprintf(2, "strbench: out of memory\n");
+    exit(1);
+  }
+
+  printf("%s %s %s %s\n", "op", "size", "byte MB/s", "ulib MB/s");
+  for(op = 0; op < NOP; op++){
+    for(n = 1024; n <= MB; n *= 4){
+      printf("%s %d %ld %ld\n", opname[op], n,
+             rate(op, 0, n, total), rate(op, 1, n, total));
+    }
+  }
+  exit(0);
+}
@@ -0,0 +1,45 @@
+// Names of the system calls, indexed by SYS_xxx
+// from kernel/syscall.h, for sysstat and strace.
+
+#define NSYS 40
+
+static char *sysnames[NSYS] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_prof]    "prof",
+[SYS_profread] "profread",
+[SYS_sysstat] "sysstat",
+[SYS_trace]   "trace",
+[SYS_traceread] "traceread",
+[SYS_ringsetup] "ringsetup",
+[SYS_ring_enter] "ring_enter",
+[SYS_perf]    "perf",
+[SYS_getdents] "getdents",
+[SYS_fstatat] "fstatat",
+[SYS_sendfile] "sendfile",
+[SYS_pread]   "pread",
+[SYS_pwrite]  "pwrite",
+[SYS_readv]   "readv",
+[SYS_writev]  "writev",
+[SYS_mmap]    "mmap",
+[SYS_munmap]  "munmap",
+};
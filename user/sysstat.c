@@ -0,0 +1,71 @@
+// Print per-system-call counts, time and latency histograms.
+// With a command, only the calls made while it ran count
+// (along with any made by other processes meanwhile).
+//
+//   sysstat [-h] [command args...]
+//
+// -h also prints each call's log2 latency histogram.
+// times are in r_time() units of 100 ns.
+
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+#include "user/sysnames.h"
+
+struct sysstat before[NSYS], after[NSYS];
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, pid, hist = 0;
+  struct sysstat *s;
+
+  if(argc > 1 && strcmp(argv[1], "-h") == 0){
+    hist = 1;
+    argc--;
+    argv++;
+  }
+
+  if(argc > 1){
+    if(sysstat(before, NSYS) < 0){
+      fprintf(2, "sysstat: sysstat failed\n");
+      exit(1);
+    }
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "sysstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv+1);
+      fprintf(2, "sysstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+
+  if((n = sysstat(after, NSYS)) < 0){
+    fprintf(2, "sysstat: sysstat failed\n");
+    exit(1);
+  }
+
+  printf("%s %s %s %s\n", "syscall", "calls", "time", "avg");
+  for(i = 0; i < n; i++){
+    s = &after[i];
+    s->count -= before[i].count;
+    s->time -= before[i].time;
+    for(j = 0; j < NSYSHIST; j++)
+      s->hist[j] -= before[i].hist[j];
+    if(s->count == 0)
+      continue;
+    printf("%s %ld %ld %ld\n", sysnames[i] ? sysnames[i] : "?", s->count,
+           s->time, s->time / s->count);
+    if(!hist)
+      continue;
+    for(j = 0; j < NSYSHIST; j++)
+      if(s->hist[j])
+        printf("  [%ld, %ld) %ld\n", j ? 1L << j : 0L, 2L << j, s->hist[j]);
+  }
+  exit(0);
+}
@@ -0,0 +1,131 @@
+// Time the round trip into the kernel and back, and a
+// context switch between two processes, so that changes
+// to the trap path (e.g. TLB flushing) can be compared.
+// Also time the same trivial work batched through the
+// ring_enter() ring, to see what a trap costs per call.
+//
+//   trapbench [n]
+
+#include "kernel/types.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+#define N 100000
+
+// a clock tick is about 1/10th of a second.
+#define NSPERTICK 100000000UL
+
+void
+report(char *what, int n, int ticks)
+{
+  printf("%s: %d in %d ticks", what, n, ticks);
+  if(ticks > 0)
+    printf(", %ld ns each", ticks * NSPERTICK / n);
+  printf("\n");
+}
+
+// n trivial system calls, and the same through
+// the page that ulib's getpid() reads instead.
+void
+syscalls(int n)
+{
+  int i, t0;
+
+  t0 = uptime();
+  for(i = 0; i < n; i++)
+    _getpid();
+  report("getpid syscall", n, uptime() - t0);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++)
+    getpid();
+  report("getpid page", n, uptime() - t0);
+}
+
+// n no-op submissions to the ring, a full ring per trap.
+void
+ringnops(int n)
+{
+  struct ring *r;
+  int i, k, t0;
+
+  if((r = ringsetup()) == (struct ring*)-1){
+    fprintf(2, "trapbench: ringsetup failed\n");
+    exit(1);
+  }
+
+  t0 = uptime();
+  for(i = 0; i < n; i += k){
+    for(k = 0; k < NRING && i + k < n; k++){
+      r->sq[r->sqtail % NRING].op = RING_NOP;
+      r->sqtail++;
+    }
+    if(ring_enter(k) != k){
+      fprintf(2, "trapbench: ring_enter failed\n");
+      exit(1);
+    }
+    r->cqhead = r->cqtail;
+  }
+  report("ring nop", n, uptime() - t0);
+}
+
+// bounce a byte between two processes over a pair
+// of pipes n times; each round trip needs at least
+// two context switches on a single hart.
+void
+pingpong(int n)
+{
+  int ping[2], pong[2];
+  int i, pid, t0;
+  char c = 0;
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    fprintf(2, "trapbench: pipe failed\n");
+    exit(1);
+  }
+
+  if((pid = fork()) < 0){
+    fprintf(2, "trapbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(ping[1]);
+    close(pong[0]);
+    while(read(ping[0], &c, 1) == 1)
+      write(pong[1], &c, 1);
+    exit(0);
+  }
+  close(ping[0]);
+  close(pong[1]);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1){
+      fprintf(2, "trapbench: pingpong failed\n");
+      exit(1);
+    }
+  }
+  report("pingpong", n, uptime() - t0);
+
+  close(ping[1]);
+  close(pong[0]);
+  wait(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = N;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    fprintf(2, "usage: trapbench [n]\n");
+    exit(1);
+  }
+
+  syscalls(n);
+  ringnops(n);
+  pingpong(n > 10 ? n / 10 : 1);
+  exit(0);
+}
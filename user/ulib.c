@@ -1,6 +1,9 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/usyscall.h"
 #include "user/user.h"
 
 //
@@ -14,53 +17,71 @@ start()
   exit(0);
 }
 
-char*
-strcpy(char *s, const char *t)
+// set by printf.c once it buffers output. a hook rather
+// than a call, since forktest links without printf.o.
+void (*_flushout)(void);
+
+// flush buffered output first, so that none is lost
+// or, after fork, written twice.
+int
+fork(void)
 {
-  char *os;
+  if(_flushout)
+    _flushout();
+  return _fork();
+}
 
-  os = s;
-  while((*s++ = *t++) != 0)
-    ;
-  return os;
+int
+exit(int status)
+{
+  if(_flushout)
+    _flushout();
+  _exit(status);
 }
 
 int
-strcmp(const char *p, const char *q)
+exec(const char *path, char **argv)
 {
-  while(*p && *p == *q)
-    p++, q++;
-  return (uchar)*p - (uchar)*q;
+  if(_flushout)
+    _flushout();
+  return _exec(path, argv);
 }
 
-uint
-strlen(const char *s)
+// the kernel keeps these in pages mapped read-only
+// into every process, so they need no system call.
+int
+getpid(void)
 {
-  int n;
+  return ((struct usyscall*)USYSCALL)->pid;
+}
 
-  for(n = 0; s[n]; n++)
-    ;
-  return n;
+int
+uptime(void)
+{
+  return __atomic_load_n(&((struct ushared*)USHARED)->ticks, __ATOMIC_RELAXED);
 }
 
-void*
-memset(void *dst, int c, uint n)
+// time since boot, with the resolution of the time CSR.
+int
+clock_gettime(struct timespec *ts)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
-  }
-  return dst;
+  uint64 t, hz = ((struct ushared*)USHARED)->timefreq;
+
+  asm volatile("rdtime %0" : "=r" (t));
+  ts->tv_sec = t / hz;
+  ts->tv_nsec = (t % hz) * 1000000000 / hz;
+  return 0;
 }
 
 char*
-strchr(const char *s, char c)
+strcpy(char *s, const char *t)
 {
-  for(; *s; s++)
-    if(*s == c)
-      return (char*)s;
-  return 0;
+  char *os;
+
+  os = s;
+  while((*s++ = *t++) != 0)
+    ;
+  return os;
 }
 
 char*
@@ -69,6 +90,9 @@ gets(char *buf, int max)
   int i, cc;
   char c;
 
+  // show any prompt before waiting for input.
+  if(_flushout)
+    _flushout();
   for(i=0; i+1 < max; ){
     cc = read(0, &c, 1);
     if(cc < 1)
@@ -84,15 +108,7 @@ gets(char *buf, int max)
 int
 stat(const char *n, struct stat *st)
 {
-  int fd;
-  int r;
-
-  fd = open(n, O_RDONLY);
-  if(fd < 0)
-    return -1;
-  r = fstat(fd, st);
-  close(fd);
-  return r;
+  return fstatat(AT_FDCWD, n, st);
 }
 
 int
@@ -106,42 +122,3 @@ atoi(const char *s)
   return n;
 }
 
-void*
-memmove(void *vdst, const void *vsrc, int n)
-{
-  char *dst;
-  const char *src;
-
-  dst = vdst;
-  src = vsrc;
-  if (src > dst) {
-    while(n-- > 0)
-      *dst++ = *src++;
-  } else {
-    dst += n;
-    src += n;
-    while(n-- > 0)
-      *--dst = *--src;
-  }
-  return vdst;
-}
-
-int
-memcmp(const void *s1, const void *s2, uint n)
-{
-  const char *p1 = s1, *p2 = s2;
-  while (n-- > 0) {
-    if (*p1 != *p2) {
-      return *p1 - *p2;
-    }
-    p1++;
-    p2++;
-  }
-  return 0;
-}
-
-void *
-memcpy(void *dst, const void *src, uint n)
-{
-  return memmove(dst, src, n);
-}
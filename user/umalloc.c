@@ -3,88 +3,308 @@
 #include "user/user.h"
 #include "kernel/param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with size classes.
+//
+// Every block starts with a 16-byte header. Blocks of up to
+// SMALLMAX bytes (header included) come in a fixed set of
+// size classes, each with its own free list; they are carved
+// from slabs taken from the large-block allocator and never
+// given back to it, so malloc and free of a small block just
+// pop and push a list.
+//
+// Larger blocks live in regions got from sbrk, each ending in
+// an in-use fence header. Each header records the size of the
+// block before it as well as its own, so free can merge a
+// block with free neighbours on both sides in constant time.
+// Free large blocks sit on one of NBIN lists by power-of-two
+// size, and malloc takes the first that fits.
 
-typedef long Align;
+typedef struct header {
+  uint64 prev;        // large: size of the block before, or 0
+                      // small: size class
+  uint64 size;        // block size in bytes, including header,
+                      // ORed with the flags below
+} Header;
 
-union header {
-  struct {
-    union header *ptr;
-    uint size;
-  } s;
-  Align x;
+#define INUSE     1
+#define SMALL     2
+#define FLAGS     15
+#define SIZE(h)   ((h)->size & ~FLAGS)
+
+#define HDR       sizeof(Header)
+#define SMALLMAX  2048
+#define SLAB      16384     // bytes carved into small blocks at once
+#define REGION    65536     // least to ask sbrk for at once
+#define NBIN      32
+
+// a free large block; the links overlay its data.
+typedef struct fblock {
+  Header h;
+  struct fblock *next;
+  struct fblock *prev;
+} Fblock;
+
+// least worth splitting off as a free large block.
+#define LARGEMIN  (sizeof(Fblock) + HDR)
+
+static uint classsize[] = {
+  32, 48, 64, 80, 96, 128, 160, 192, 256,
+  384, 512, 768, 1024, 1536, 2048,
 };
+#define NCLASS (sizeof(classsize)/sizeof(classsize[0]))
 
-typedef union header Header;
+static uchar classof[SMALLMAX/16 + 1];  // by size in 16-byte units
+static int classready;
+static void *freesmall[NCLASS];
+static Fblock *bins[NBIN];
 
-static Header base;
-static Header *freep;
+static Header*
+nextblock(Header *h)
+{
+  return (Header*)((char*)h + SIZE(h));
+}
 
-void
-free(void *ap)
+static int
+binof(uint64 size)
 {
-  Header *bp, *p;
+  int b = 0;
 
-  bp = (Header*)ap - 1;
-  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-      break;
-  if(bp + bp->s.size == p->s.ptr){
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else
-    bp->s.ptr = p->s.ptr;
-  if(p + p->s.size == bp){
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else
-    p->s.ptr = bp;
-  freep = p;
+  while(b < NBIN-1 && (size >> (b+1)) != 0)
+    b++;
+  return b;
 }
 
-static Header*
-morecore(uint nu)
+static void
+binpush(Fblock *f)
+{
+  int b = binof(SIZE(&f->h));
+
+  f->prev = 0;
+  f->next = bins[b];
+  if(bins[b])
+    bins[b]->prev = f;
+  bins[b] = f;
+}
+
+static void
+binunlink(Fblock *f)
+{
+  if(f->prev)
+    f->prev->next = f->next;
+  else
+    bins[binof(SIZE(&f->h))] = f->next;
+  if(f->next)
+    f->next->prev = f->prev;
+}
+
+// Put large block h, not in use, on a free list,
+// first merging it with free neighbours.
+static void
+largefree(Header *h)
 {
+  Header *n, *p;
+  uint64 size = SIZE(h);
+
+  n = nextblock(h);
+  if(!(n->size & INUSE)){
+    binunlink((Fblock*)n);
+    size += SIZE(n);
+  }
+  if(h->prev != 0){
+    p = (Header*)((char*)h - h->prev);
+    if(!(p->size & INUSE)){
+      binunlink((Fblock*)p);
+      size += SIZE(p);
+      h = p;
+    }
+  }
+  h->size = size;
+  nextblock(h)->prev = size;
+  binpush((Fblock*)h);
+}
+
+// Get a new region of at least size bytes from sbrk,
+// and put it on a free list.
+static int
+morecore(uint64 size)
+{
+  uint64 n = size + HDR;
   char *p;
-  Header *hp;
+  Header *h, *fence;
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
-  if(p == (char*)-1)
-    return 0;
-  hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
-  return freep;
+  if(n > 0x7fffffff)
+    return -1;
+  // keep headers 16-byte aligned, whatever
+  // else has moved the break.
+  p = sbrk(0);
+  if((uint64)p & 15)
+    sbrk(16 - ((uint64)p & 15));
+  if(n < REGION)
+    n = REGION;
+  if((p = sbrk(n)) == (char*)-1){
+    // settle for just enough.
+    n = size + HDR;
+    if(n >= REGION || (p = sbrk(n)) == (char*)-1)
+      return -1;
+  }
+  h = (Header*)p;
+  h->prev = 0;
+  h->size = n - HDR;
+  fence = nextblock(h);
+  fence->prev = h->size;
+  fence->size = INUSE;
+  largefree(h);
+  return 0;
+}
+
+// Allocate a large block of size bytes, header included.
+static Header*
+largealloc(uint64 size)
+{
+  Fblock *f;
+  Header *h, *rest;
+  int b;
+
+  if(size < sizeof(Fblock))
+    size = sizeof(Fblock);
+  for(;;){
+    b = binof(size);
+    // the first bin may hold blocks too small;
+    // any block in a higher one will do.
+    for(f = bins[b]; f && SIZE(&f->h) < size; f = f->next)
+      ;
+    for(b++; f == 0 && b < NBIN; b++)
+      f = bins[b];
+    if(f)
+      break;
+    if(morecore(size) < 0)
+      return 0;
+  }
+
+  binunlink(f);
+  h = &f->h;
+  if(SIZE(h) - size >= LARGEMIN){
+    rest = (Header*)((char*)h + size);
+    rest->prev = size;
+    rest->size = SIZE(h) - size;
+    nextblock(rest)->prev = rest->size;
+    h->size = size;
+    binpush((Fblock*)rest);
+  }
+  h->size |= INUSE;
+  return h;
+}
+
+// Carve a slab into free blocks of class c.
+static int
+smallrefill(int c)
+{
+  Header *slab, *h;
+  char *p, *end;
+  uint sz = classsize[c];
+
+  if((slab = largealloc(SLAB)) == 0)
+    return -1;
+  end = (char*)slab + SIZE(slab);
+  for(p = (char*)(slab + 1); p + sz <= end; p += sz){
+    h = (Header*)p;
+    h->prev = c;
+    h->size = sz | SMALL;
+    *(void**)(h + 1) = freesmall[c];
+    freesmall[c] = h;
+  }
+  return 0;
+}
+
+static void
+classinit(void)
+{
+  int c = 0;
+  uint u;
+
+  for(u = 0; u <= SMALLMAX/16; u++){
+    while(classsize[c] < u*16)
+      c++;
+    classof[u] = c;
+  }
+  classready = 1;
+}
+
+void
+free(void *ap)
+{
+  Header *h;
+  int c;
+
+  if(ap == 0)
+    return;
+  h = (Header*)ap - 1;
+  if(h->size & SMALL){
+    c = h->prev;
+    *(void**)ap = freesmall[c];
+    freesmall[c] = h;
+  } else {
+    h->size &= ~INUSE;
+    largefree(h);
+  }
 }
 
 void*
 malloc(uint nbytes)
 {
-  Header *p, *prevp;
-  uint nunits;
+  Header *h;
+  uint64 size;
+  int c;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
-    base.s.size = 0;
+  size = ((uint64)nbytes + HDR + 15) & ~15;
+  if(size <= SMALLMAX){
+    if(!classready)
+      classinit();
+    c = classof[size/16];
+    if(freesmall[c] == 0 && smallrefill(c) < 0)
+      return 0;
+    h = freesmall[c];
+    freesmall[c] = *(void**)(h + 1);
+    return (void*)(h + 1);
   }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
-      }
-      freep = prevp;
-      return (void*)(p + 1);
-    }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
+  if((h = largealloc(size)) == 0)
+    return 0;
+  return (void*)(h + 1);
+}
+
+void*
+calloc(uint n, uint size)
+{
+  uint64 total = (uint64)n * size;
+  void *p;
+
+  if(total > 0xffffffff)
+    return 0;
+  if((p = malloc(total)) != 0)
+    memset(p, 0, total);
+  return p;
+}
+
+void*
+realloc(void *ap, uint nbytes)
+{
+  Header *h;
+  uint64 have;
+  void *p;
+
+  if(ap == 0)
+    return malloc(nbytes);
+  if(nbytes == 0){
+    free(ap);
+    return 0;
   }
+  h = (Header*)ap - 1;
+  have = SIZE(h) - HDR;
+  if(nbytes <= have)
+    return ap;
+  if((p = malloc(nbytes)) == 0)
+    return 0;
+  memmove(p, ap, have);
+  free(ap);
+  return p;
 }
@@ -22,8 +22,44 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int prof(int);
+int profread(void*, int);
+struct sysstat;
+int sysstat(struct sysstat*, int);
+int trace(int, uint64);
+struct tracerec;
+int traceread(struct tracerec*, int);
+struct ring;
+struct ring* ringsetup(void);
+int ring_enter(int);
+struct perfcount;
+int perf(struct perfcount*);
+struct dirstat;
+int getdents(int, struct dirstat*, int);
+int fstatat(int, const char*, struct stat*);
+int sendfile(int, int, uint*, int);
+int pread(int, void*, int, uint);
+int pwrite(int, const void*, int, uint);
+struct iovec;
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+void* mmap(void*, uint64, int, int, int, uint);
+int munmap(void*, uint64);
+
+// the system calls themselves, without first
+// flushing printf's buffered output.
+int _fork(void);
+int _exit(int) __attribute__((noreturn));
+int _exec(const char*, char**);
+int _getpid(void);
+int _uptime(void);
 
 // ulib.c
+struct timespec {
+  uint64 tv_sec;
+  uint64 tv_nsec;
+};
+int clock_gettime(struct timespec*);
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
 void *memmove(void*, const void*, int);
@@ -31,13 +67,46 @@ char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void fprintf(int, const char*, ...) __attribute__ ((format (printf, 2, 3)));
 void printf(const char*, ...) __attribute__ ((format (printf, 1, 2)));
+void fflush(int);
 char* gets(char*, int max);
+extern void (*_flushout)(void);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
+void* memchr(const void*, int, uint);
 void *memcpy(void *, const void *, uint);
 
+// lineio.c
+#define LRBUFSZ (64*1024)
+#define LWBUFSZ (8*1024)
+
+struct lreader {
+  int fd;
+  char *buf;          // LRBUFSZ bytes, page-aligned
+  char *mem;          // from malloc, holding buf
+  int r;              // next line starts at buf[r]
+  int w;              // data read so far ends at buf[w]
+  int eof;
+  int err;            // read() failed
+};
+
+struct lwriter {
+  int fd;
+  int n;
+  int linebuf;        // flush after each line
+  char buf[LWBUFSZ];
+};
+
+int lrinit(struct lreader*, int);
+char* lrline(struct lreader*, int*);
+void lrfree(struct lreader*);
+void lwinit(struct lwriter*, int);
+void lwwrite(struct lwriter*, char*, int);
+void lwflush(struct lwriter*);
+
 // umalloc.c
 void* malloc(uint);
 void free(void*);
+void* calloc(uint, uint);
+void* realloc(void*, uint);
@@ -7,6 +7,9 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/ring.h"
+#include "kernel/perf.h"
+#include "kernel/uio.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -788,6 +791,61 @@ pipe1(char *s)
   }
 }
 
+// writes of at most PIPESIZE bytes from several processes
+// must not be interleaved.
+void
+pipeatomic(char *s)
+{
+  int fds[2], i, j, n, xstatus;
+  enum { NCHILD=4, NREC=200, SZ=100 };
+  char rec[SZ];
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NCHILD; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("%s: fork() failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(fds[0]);
+      memset(rec, 'a' + i, SZ);
+      for(j = 0; j < NREC; j++){
+        if(write(fds[1], rec, SZ) != SZ){
+          printf("%s: write failed\n", s);
+          exit(1);
+        }
+      }
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  // read exactly one record at a time.
+  for(i = 0; i < NCHILD * NREC; i++){
+    for(n = 0; n < SZ; n += j){
+      if((j = read(fds[0], rec + n, SZ - n)) <= 0){
+        printf("%s: short read\n", s);
+        exit(1);
+      }
+    }
+    for(j = 1; j < SZ; j++){
+      if(rec[j] != rec[0]){
+        printf("%s: interleaved write\n", s);
+        exit(1);
+      }
+    }
+  }
+  close(fds[0]);
+  for(i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+}
+
 
 // test if child is killed (status = -1)
 void
@@ -1962,7 +2020,7 @@ iref(char *s)
 void
 forktest(char *s)
 {
-  enum{ N = 1000 };
+  enum{ N = 2*NPROC };
   int n, pid;
 
   for(n=0; n<N; n++){
@@ -1979,7 +2037,7 @@ forktest(char *s)
   }
 
   if(n == N){
-    printf("%s: fork claimed to work 1000 times!\n", s);
+    printf("%s: fork claimed to work %d times!\n", s, N);
     exit(1);
   }
 
@@ -2571,6 +2629,639 @@ sbrk8000(char *s)
 
 
 
+// grow by enough to cover whole superpages, check that the
+// memory is zeroed, that fork copies it, and that shrinking
+// into the middle of a superpage keeps the rest intact.
+void
+superpg(char *s)
+{
+  uint64 top = (uint64) sbrk(0);
+  uint64 n = 2*SUPERPGSIZE + SUPERPGSIZE - top % SUPERPGSIZE;
+  char *a, *p;
+  int pid, xstatus;
+
+  a = sbrk(n);
+  if(a == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(p = a; p < a + n; p += PGSIZE){
+    if(*p != 0){
+      printf("%s: sbrk memory not zeroed at %p\n", s, p);
+      exit(1);
+    }
+    *p = (uint64)p >> 12;
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(p = a; p < a + n; p += PGSIZE){
+      if(*p != (char)((uint64)p >> 12)){
+        printf("%s: fork copy wrong at %p\n", s, p);
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+
+  // cut the last superpage in half.
+  sbrk(-(SUPERPGSIZE/2));
+  for(p = a; p < a + n - SUPERPGSIZE/2; p += PGSIZE){
+    if(*p != (char)((uint64)p >> 12)){
+      printf("%s: shrink lost data at %p\n", s, p);
+      exit(1);
+    }
+  }
+  sbrk(-(n - SUPERPGSIZE/2));
+}
+
+static void
+ringsub(struct ring *r, int op, int fd, void *addr, int n)
+{
+  struct sqe *e = &r->sq[r->sqtail % NRING];
+
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint64)addr;
+  e->n = n;
+  e->flags = 0;
+  e->data = r->sqtail;
+  r->sqtail++;
+}
+
+// run everything submitted, and return the result
+// of the submission at index i.
+static int
+ringres(char *s, struct ring *r, uint i)
+{
+  int n = r->sqtail - r->sqhead;
+  struct cqe *c;
+
+  if(ring_enter(n) != n){
+    printf("%s: ring_enter did not run %d\n", s, n);
+    exit(1);
+  }
+  for(; r->cqhead != r->cqtail; r->cqhead++){
+    c = &r->cq[r->cqhead % NRING];
+    if(c->data == i)
+      return c->res;
+  }
+  printf("%s: no completion for %d\n", s, i);
+  exit(1);
+}
+
+// file system calls batched through ring_enter().
+void
+ringtest(char *s)
+{
+  struct ring *r;
+  struct stat st;
+  char buf[16];
+  int fd, pid, xstatus;
+  uint i;
+
+  if(ring_enter(1) != -1){
+    printf("%s: ring_enter without a ring succeeded\n", s);
+    exit(1);
+  }
+  r = ringsetup();
+  if(r == (struct ring*)-1 || ringsetup() != r){
+    printf("%s: ringsetup failed\n", s);
+    exit(1);
+  }
+
+  unlink("ringfile");
+  i = r->sqtail;
+  ringsub(r, RING_OPEN, 0, "ringfile", O_CREATE|O_RDWR);
+  if((fd = ringres(s, r, i)) < 0){
+    printf("%s: ring open failed\n", s);
+    exit(1);
+  }
+
+  // a batch: write, fstat, a bad descriptor, close.
+  i = r->sqtail;
+  ringsub(r, RING_WRITE, fd, "0123456789", 10);
+  ringsub(r, RING_FSTAT, fd, &st, 0);
+  ringsub(r, RING_READ, NOFILE, buf, 1);
+  ringsub(r, RING_CLOSE, fd, 0, 0);
+  if(ringres(s, r, i) != 10 || ringres(s, r, i+1) != 0 ||
+     ringres(s, r, i+2) != -1 || ringres(s, r, i+3) != 0){
+    printf("%s: ring batch failed\n", s);
+    exit(1);
+  }
+  if(st.size != 10 || st.type != T_FILE){
+    printf("%s: ring fstat wrong\n", s);
+    exit(1);
+  }
+
+  // the ring is copied by fork.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    i = r->sqtail;
+    ringsub(r, RING_OPEN, 0, "ringfile", O_RDONLY);
+    if((fd = ringres(s, r, i)) < 0){
+      printf("%s: ring open in child failed\n", s);
+      exit(1);
+    }
+    i = r->sqtail;
+    ringsub(r, RING_READ, fd, buf, sizeof(buf));
+    ringsub(r, RING_CLOSE, fd, 0, 0);
+    if(ringres(s, r, i) != 10 || memcmp(buf, "0123456789", 10) != 0){
+      printf("%s: ring read in child failed\n", s);
+      exit(1);
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  unlink("ringfile");
+  exit(xstatus);
+}
+
+// getpid(), uptime() and clock_gettime() read pages the
+// kernel shares with the process; check that they agree
+// with the system calls, and that the pages are read-only.
+void
+usyscalltest(char *s)
+{
+  struct timespec a, b;
+  int pid, xstatus, t;
+
+  if(getpid() != _getpid()){
+    printf("%s: getpid %d, system call says %d\n", s, getpid(), _getpid());
+    exit(1);
+  }
+  t = uptime();
+  if(t < _uptime() - 1 || t > _uptime()){
+    printf("%s: uptime %d, system call says %d\n", s, t, _uptime());
+    exit(1);
+  }
+
+  clock_gettime(&a);
+  sleep(2);
+  clock_gettime(&b);
+  if(b.tv_nsec >= 1000000000 || b.tv_sec < a.tv_sec ||
+     (b.tv_sec == a.tv_sec && b.tv_nsec <= a.tv_nsec)){
+    printf("%s: clock_gettime went backwards\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(getpid() != _getpid()){
+      printf("%s: child getpid wrong\n", s);
+      exit(1);
+    }
+    // should be killed.
+    *(volatile int*)USYSCALL = 0;
+    exit(1);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: wrote to the read-only page, or getpid wrong\n", s);
+    exit(1);
+  }
+}
+
+// perf() counts the caller's cycles and instructions,
+// and adds a child's to its parent's when it is waited for.
+void
+perftest(char *s)
+{
+  struct perfcount a, b;
+  volatile int i;
+  int pid;
+
+  if(perf(&a) < 0){
+    printf("%s: perf failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 100000; i++)
+    ;
+  perf(&b);
+  if(b.instret < a.instret + 100000 || b.cycles <= a.cycles){
+    printf("%s: counts did not grow\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < 100000; i++)
+      ;
+    exit(0);
+  }
+  wait(0);
+  perf(&b);
+  if(b.cinstret < a.cinstret + 100000){
+    printf("%s: child's counts not added\n", s);
+    exit(1);
+  }
+}
+
+// sendfile() should copy from a file to a file or a pipe,
+// from the file offset or from an offset passed in.
+void
+sendfiletest(char *s)
+{
+  enum { SZ=3000 };
+  int in, out, fds[2], i, n;
+  uint off;
+
+  unlink("sfin");
+  unlink("sfout");
+  if((in = open("sfin", O_CREATE|O_RDWR)) < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++)
+    buf[i] = i % 251;
+  if(write(in, buf, SZ) != SZ){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  close(in);
+
+  in = open("sfin", O_RDONLY);
+  out = open("sfout", O_CREATE|O_RDWR);
+  if(in < 0 || out < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  if((n = sendfile(out, in, 0, SZ + 100)) != SZ || sendfile(out, in, 0, 100) != 0){
+    printf("%s: sendfile to file returned %d\n", s, n);
+    exit(1);
+  }
+  close(out);
+  out = open("sfout", O_RDONLY);
+  memset(buf, 0, SZ);
+  if(read(out, buf, sizeof(buf)) != SZ){
+    printf("%s: sfout has the wrong size\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++){
+    if((buf[i] & 0xff) != i % 251){
+      printf("%s: sfout has the wrong data\n", s);
+      exit(1);
+    }
+  }
+  close(out);
+
+  // from an explicit offset, into a pipe.
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  off = 1000;
+  if(sendfile(fds[1], in, &off, 100) != 100 || off != 1100){
+    printf("%s: sendfile to pipe failed\n", s);
+    exit(1);
+  }
+  if(read(fds[0], buf, 100) != 100 || (buf[0] & 0xff) != 1000 % 251){
+    printf("%s: pipe has the wrong data\n", s);
+    exit(1);
+  }
+  // a pipe cannot be the source.
+  if(sendfile(1, fds[0], 0, 1) != -1){
+    printf("%s: sendfile from a pipe succeeded\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  close(in);
+  unlink("sfin");
+  unlink("sfout");
+}
+
+// pread() and pwrite() work at an offset without moving the
+// file's own; readv() and writev() gather and scatter.
+void
+vectortest(char *s)
+{
+  struct iovec iov[3];
+  char a[8], b[8], c[8];
+  int fd;
+
+  unlink("vecfile");
+  if((fd = open("vecfile", O_CREATE|O_RDWR)) < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = "hdr:";
+  iov[0].iov_len = 4;
+  iov[1].iov_base = "payload";
+  iov[1].iov_len = 7;
+  iov[2].iov_base = "\n";
+  iov[2].iov_len = 1;
+  if(writev(fd, iov, 3) != 12){
+    printf("%s: writev failed\n", s);
+    exit(1);
+  }
+  if(pwrite(fd, "PAY", 3, 4) != 3){
+    printf("%s: pwrite failed\n", s);
+    exit(1);
+  }
+  // the offset is still at the end.
+  if(write(fd, "x", 1) != 1 || pread(fd, a, 8, 4) != 8 || memcmp(a, "PAYload\n", 8) != 0){
+    printf("%s: pread got the wrong data\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("vecfile", O_RDONLY);
+  memset(a, 0, sizeof(a));
+  memset(b, 0, sizeof(b));
+  memset(c, 0, sizeof(c));
+  iov[0].iov_base = a;
+  iov[0].iov_len = 4;
+  iov[1].iov_base = b;
+  iov[1].iov_len = 3;
+  iov[2].iov_base = c;
+  iov[2].iov_len = sizeof(c);
+  if(readv(fd, iov, 3) != 13 || memcmp(a, "hdr:", 4) != 0 ||
+     memcmp(b, "PAY", 3) != 0 || memcmp(c, "load\nx", 6) != 0){
+    printf("%s: readv got the wrong data\n", s);
+    exit(1);
+  }
+  if(readv(fd, iov, IOV_MAX + 1) != -1){
+    printf("%s: readv of too many buffers succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("vecfile");
+}
+
+// mmap(): private and shared mappings, write-back on munmap
+// and exit, fork, partial munmap, and copies into and out of
+// pages not yet faulted in.
+void
+mmaptest(char *s)
+{
+  enum { SZ=PGSIZE*2+1000 };
+  char *p, *q;
+  int fd, fds[2], i, pid, xstatus;
+
+  unlink("mmapfile");
+  if((fd = open("mmapfile", O_CREATE|O_RDWR)) < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++)
+    buf[i] = 'a' + i % 26;
+  if(write(fd, buf, SZ) != SZ){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+
+  // private: writes stay in this process.
+  p = mmap(0, SZ, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1){
+    printf("%s: mmap private failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++){
+    if(p[i] != 'a' + i % 26){
+      printf("%s: wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  if(p[SZ] != 0 || p[PGSIZE*3-1] != 0){
+    printf("%s: past the end not zero\n", s);
+    exit(1);
+  }
+  p[0] = 'X';
+  if(munmap(p, SZ) < 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+  if(pread(fd, buf, 1, 0) != 1 || buf[0] != 'a'){
+    printf("%s: private write reached the file\n", s);
+    exit(1);
+  }
+  // a read of the file into a page of it not yet faulted in.
+  p = mmap(0, SZ, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1 || pread(fd, p + PGSIZE, 5, 0) != 5 ||
+     p[PGSIZE] != 'a' || p[PGSIZE+5] != 'a' + (PGSIZE+5) % 26 || munmap(p, SZ) < 0){
+    printf("%s: read into own mapping failed\n", s);
+    exit(1);
+  }
+  // a clean private page keeps its content when the file changes.
+  p = mmap(0, PGSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1 || p[0] != 'a' || pwrite(fd, "P", 1, 0) != 1 ||
+     p[0] != 'a' || pwrite(fd, "a", 1, 0) != 1 || munmap(p, PGSIZE) < 0){
+    printf("%s: private mapping saw a write\n", s);
+    exit(1);
+  }
+
+  // shared: a child's writes are seen by the parent,
+  // and reach the file when the last one unmaps.
+  p = mmap(0, SZ, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == (char*)-1){
+    printf("%s: mmap shared failed\n", s);
+    exit(1);
+  }
+  p[1] = 'Y';
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(p[1] != 'Y')
+      exit(1);
+    p[2] = 'Z';
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0 || p[2] != 'Z'){
+    printf("%s: shared write not seen\n", s);
+    exit(1);
+  }
+  // another mapping, and write(), share the same page.
+  q = mmap(0, PGSIZE, PROT_READ, MAP_SHARED, fd, 0);
+  if(q == (char*)-1 || q[2] != 'Z' || pwrite(fd, "Q", 1, 3) != 1 ||
+     p[3] != 'Q' || q[3] != 'Q' || munmap(q, PGSIZE) < 0){
+    printf("%s: mappings not coherent\n", s);
+    exit(1);
+  }
+  // copies into pages not yet faulted in, and out of one.
+  q = p + PGSIZE*2;
+  if(fstat(fd, (struct stat*)(q + 64)) < 0 || ((struct stat*)(q + 64))->size != SZ){
+    printf("%s: fstat into mapping failed\n", s);
+    exit(1);
+  }
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(write(fds[1], "hello", 5) != 5 || read(fds[0], q + 10, 5) != 5 || q[10] != 'h'){
+    printf("%s: read into mapping failed\n", s);
+    exit(1);
+  }
+  if(write(fds[1], p + PGSIZE, 10) != 10 || read(fds[0], buf, 10) != 10 ||
+     buf[0] != 'a' + PGSIZE % 26){
+    printf("%s: write from mapping failed\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  // unmap the first page only; the rest stays.
+  if(munmap(p, PGSIZE) < 0 || q[11] != 'e'){
+    printf("%s: partial munmap failed\n", s);
+    exit(1);
+  }
+  if(munmap(p + PGSIZE, SZ - PGSIZE) < 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+  if(pread(fd, buf, 4, 0) != 4 || buf[1] != 'Y' || buf[2] != 'Z' || buf[3] != 'Q' ||
+     pread(fd, buf, 2, PGSIZE*2 + 10) != 2 || buf[0] != 'h'){
+    printf("%s: shared writes not in the file\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // a read-only file can't be mapped shared and writable.
+  fd = open("mmapfile", O_RDONLY);
+  if(mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0) != (char*)-1){
+    printf("%s: writable mapping of read-only file\n", s);
+    exit(1);
+  }
+  // but exit() unmaps what is left.
+  if(mmap(0, PGSIZE, PROT_READ, MAP_SHARED, fd, 0) == (char*)-1){
+    printf("%s: mmap read-only failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("mmapfile");
+}
+
+// getdents() should list a directory with the entries'
+// types, and fstatat() look names up relative to it.
+void
+getdentstest(char *s)
+{
+  struct dirstat ds[4];
+  struct stat st;
+  int dfd, fd, i, n, seen;
+
+  mkdir("gddir");
+  mkdir("gddir/sub");
+  if((fd = open("gddir/file", O_CREATE|O_RDWR)) < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  write(fd, "hello", 5);
+  close(fd);
+
+  if((dfd = open("gddir", O_RDONLY)) < 0){
+    printf("%s: open gddir failed\n", s);
+    exit(1);
+  }
+  // a small array, so that it takes more than one call.
+  seen = 0;
+  while((n = getdents(dfd, ds, 3)) > 0){
+    for(i = 0; i < n; i++){
+      if(strcmp(ds[i].name, "sub") == 0 && ds[i].type == T_DIR)
+        seen |= 1;
+      else if(strcmp(ds[i].name, "file") == 0 && ds[i].type == T_FILE && ds[i].size == 5)
+        seen |= 2;
+      else if(strcmp(ds[i].name, ".") == 0 || strcmp(ds[i].name, "..") == 0)
+        seen |= 4;
+    }
+  }
+  if(n < 0 || seen != 7){
+    printf("%s: getdents returned %d, saw %d\n", s, n, seen);
+    exit(1);
+  }
+
+  if(fstatat(dfd, "file", &st) < 0 || st.type != T_FILE || st.size != 5){
+    printf("%s: fstatat file failed\n", s);
+    exit(1);
+  }
+  if(fstatat(dfd, "sub/..", &st) < 0 || st.type != T_DIR){
+    printf("%s: fstatat sub/.. failed\n", s);
+    exit(1);
+  }
+  if(fstatat(dfd, "nonexistent", &st) != -1){
+    printf("%s: fstatat nonexistent succeeded\n", s);
+    exit(1);
+  }
+  if((fd = open("gddir/file", O_RDONLY)) < 0){
+    printf("%s: open file failed\n", s);
+    exit(1);
+  }
+  if(getdents(fd, ds, 1) != -1){
+    printf("%s: getdents of a file succeeded\n", s);
+    exit(1);
+  }
+  if(fstatat(fd, "x", &st) != -1){
+    printf("%s: fstatat relative to a file succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  close(dfd);
+  unlink("gddir/file");
+  unlink("gddir/sub");
+  unlink("gddir");
+}
+
+// calloc() zeroes, and realloc() keeps the contents,
+// for small and large blocks alike.
+void
+realloctest(char *s)
+{
+  char *p, *q;
+  int i, n;
+
+  for(n = 1; n <= 65536; n *= 4){
+    p = calloc(n, 1);
+    if(p == 0){
+      printf("%s: calloc(%d) failed\n", s, n);
+      exit(1);
+    }
+    for(i = 0; i < n; i++){
+      if(p[i] != 0){
+        printf("%s: calloc(%d) not zeroed\n", s, n);
+        exit(1);
+      }
+      p[i] = i;
+    }
+    q = realloc(p, 3*n);
+    if(q == 0){
+      printf("%s: realloc(%d) failed\n", s, 3*n);
+      exit(1);
+    }
+    for(i = 0; i < n; i++){
+      if(q[i] != (char)i){
+        printf("%s: realloc(%d) lost data\n", s, 3*n);
+        exit(1);
+      }
+    }
+    free(q);
+  }
+  if(calloc(0x10000, 0x10000) != 0){
+    printf("%s: calloc overflow not caught\n", s);
+    exit(1);
+  }
+}
+
 // regression test. test whether exec() leaks memory if one of the
 // arguments is invalid. the test passes if the kernel doesn't panic.
 void
@@ -2609,6 +3300,7 @@ struct test {
   {dirtest, "dirtest"},
   {exectest, "exectest"},
   {pipe1, "pipe1"},
+  {pipeatomic, "pipeatomic"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
   {exitwait, "exitwait"},
@@ -2649,6 +3341,15 @@ struct test {
   {sbrkbugs, "sbrkbugs" },
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
+  {superpg, "superpg"},
+  {ringtest, "ring"},
+  {usyscalltest, "usyscall"},
+  {perftest, "perf"},
+  {realloctest, "realloc"},
+  {getdentstest, "getdents"},
+  {sendfiletest, "sendfile"},
+  {vectortest, "vector"},
+  {mmaptest, "mmap"},
   {badarg, "badarg" },
 
   { 0, 0},
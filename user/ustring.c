@@ -0,0 +1,232 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// String and memory routines for user programs.
+//
+// These work a word (8 bytes) at a time once their pointers
+// are 8-byte aligned, going byte by byte only for unaligned
+// heads and tails, or when two pointers are aligned
+// differently. An aligned word load never crosses a page,
+// so the string routines may read a few bytes past the
+// terminating NUL without faulting.
+//
+// With make RVV=1, memset, memmove and strlen come from
+// ustring_rvv.S instead, using the vector extension.
+
+// may_alias, since these words overlay arbitrary objects.
+typedef uint64 __attribute__((may_alias)) word;
+
+#define WSIZE sizeof(word)
+#define WALIGNED(p) (((uint64)(p) & (WSIZE-1)) == 0)
+#define SAMEALIGN(p, q) ((((uint64)(p) ^ (uint64)(q)) & (WSIZE-1)) == 0)
+
+#define ONES  0x0101010101010101UL
+#define HIGHS 0x8080808080808080UL
+
+// non-zero if some byte of x is zero.
+#define HASZERO(x) (((x) - ONES) & ~(x) & HIGHS)
+
+#ifndef RVV
+void*
+memset(void *dst, int c, uint n)
+{
+  char *cdst = (char *) dst;
+  word *w, x;
+
+  while(n > 0 && !WALIGNED(cdst)){
+    *cdst++ = c;
+    n--;
+  }
+
+  x = (uchar)c * ONES;
+  w = (word*)cdst;
+  for(; n >= 8*WSIZE; n -= 8*WSIZE, w += 8){
+    w[0] = x; w[1] = x; w[2] = x; w[3] = x;
+    w[4] = x; w[5] = x; w[6] = x; w[7] = x;
+  }
+  for(; n >= WSIZE; n -= WSIZE)
+    *w++ = x;
+
+  cdst = (char*)w;
+  while(n-- > 0)
+    *cdst++ = c;
+  return dst;
+}
+
+void*
+memmove(void *vdst, const void *vsrc, int n)
+{
+  char *dst;
+  const char *src;
+  const word *ws;
+  word *wd;
+  int words;
+
+  if(n <= 0)
+    return vdst;
+  dst = vdst;
+  src = vsrc;
+  words = SAMEALIGN(src, dst);
+  if (src > dst) {
+    if(words){
+      while(n > 0 && !WALIGNED(dst)){
+        *dst++ = *src++;
+        n--;
+      }
+      ws = (const word*)src;
+      wd = (word*)dst;
+      for(; n >= 8*WSIZE; n -= 8*WSIZE, ws += 8, wd += 8){
+        word x0 = ws[0], x1 = ws[1], x2 = ws[2], x3 = ws[3];
+        word x4 = ws[4], x5 = ws[5], x6 = ws[6], x7 = ws[7];
+        wd[0] = x0; wd[1] = x1; wd[2] = x2; wd[3] = x3;
+        wd[4] = x4; wd[5] = x5; wd[6] = x6; wd[7] = x7;
+      }
+      for(; n >= WSIZE; n -= WSIZE)
+        *wd++ = *ws++;
+      src = (const char*)ws;
+      dst = (char*)wd;
+    }
+    while(n-- > 0)
+      *dst++ = *src++;
+  } else {
+    dst += n;
+    src += n;
+    if(words){
+      while(n > 0 && !WALIGNED(dst)){
+        *--dst = *--src;
+        n--;
+      }
+      ws = (const word*)src;
+      wd = (word*)dst;
+      for(; n >= 8*WSIZE; n -= 8*WSIZE){
+        ws -= 8;
+        wd -= 8;
+        wd[7] = ws[7]; wd[6] = ws[6]; wd[5] = ws[5]; wd[4] = ws[4];
+        wd[3] = ws[3]; wd[2] = ws[2]; wd[1] = ws[1]; wd[0] = ws[0];
+      }
+      for(; n >= WSIZE; n -= WSIZE)
+        *--wd = *--ws;
+      src = (const char*)ws;
+      dst = (char*)wd;
+    }
+    while(n-- > 0)
+      *--dst = *--src;
+  }
+  return vdst;
+}
+
+uint
+strlen(const char *s)
+{
+  const char *p = s;
+  const word *w;
+
+  for(; !WALIGNED(p); p++)
+    if(*p == 0)
+      return p - s;
+  for(w = (const word*)p; !HASZERO(*w); w++)
+    ;
+  for(p = (const char*)w; *p; p++)
+    ;
+  return p - s;
+}
+#endif
+
+void *
+memcpy(void *dst, const void *src, uint n)
+{
+  return memmove(dst, src, n);
+}
+
+int
+memcmp(const void *s1, const void *s2, uint n)
+{
+  const uchar *p1 = s1, *p2 = s2;
+
+  if(SAMEALIGN(p1, p2)){
+    while(n > 0 && !WALIGNED(p1)){
+      if(*p1 != *p2)
+        return *p1 - *p2;
+      p1++, p2++, n--;
+    }
+    // skip equal words; the bytes below find the difference.
+    while(n >= WSIZE && *(word*)p1 == *(word*)p2){
+      p1 += WSIZE;
+      p2 += WSIZE;
+      n -= WSIZE;
+    }
+  }
+  while (n-- > 0) {
+    if (*p1 != *p2) {
+      return *p1 - *p2;
+    }
+    p1++;
+    p2++;
+  }
+  return 0;
+}
+
+int
+strcmp(const char *p, const char *q)
+{
+  const word *wp, *wq;
+
+  if(SAMEALIGN(p, q)){
+    for(; !WALIGNED(p); p++, q++)
+      if(*p == 0 || *p != *q)
+        return (uchar)*p - (uchar)*q;
+    // skip equal words without a NUL.
+    wp = (const word*)p;
+    wq = (const word*)q;
+    while(*wp == *wq && !HASZERO(*wp))
+      wp++, wq++;
+    p = (const char*)wp;
+    q = (const char*)wq;
+  }
+  while(*p && *p == *q)
+    p++, q++;
+  return (uchar)*p - (uchar)*q;
+}
+
+void*
+memchr(const void *v, int c, uint n)
+{
+  const uchar *s = v;
+  const word *w;
+  word cs = (uchar)c * ONES, x;
+
+  for(; n > 0 && !WALIGNED(s); s++, n--)
+    if(*s == (uchar)c)
+      return (void*)s;
+  // skip words without c.
+  for(w = (const word*)s; n >= WSIZE; w++, n -= WSIZE){
+    x = *w ^ cs;
+    if(HASZERO(x))
+      break;
+  }
+  for(s = (const uchar*)w; n > 0; s++, n--)
+    if(*s == (uchar)c)
+      return (void*)s;
+  return 0;
+}
+
+char*
+strchr(const char *s, char c)
+{
+  const word *w;
+  word cs = (uchar)c * ONES;
+
+  for(; !WALIGNED(s); s++){
+    if(*s == 0)
+      return 0;
+    if(*s == c)
+      return (char*)s;
+  }
+  // skip words with neither c nor NUL.
+  for(w = (const word*)s; !HASZERO(*w) && !HASZERO(*w ^ cs); w++)
+    ;
+  for(s = (const char*)w; *s; s++)
+    if(*s == c)
+      return (char*)s;
+  return 0;
+}
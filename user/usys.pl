@@ -6,24 +6,27 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("name", "sym") names the stub sym instead, for
+# system calls that ulib.c wraps.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $sym = shift || $name;
+    print ".global $sym\n";
+    print "${sym}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
-entry("fork");
-entry("exit");
+entry("fork", "_fork");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
 entry("write");
 entry("close");
 entry("kill");
-entry("exec");
+entry("exec", "_exec");
 entry("open");
 entry("mknod");
 entry("unlink");
@@ -32,7 +35,24 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+entry("getpid", "_getpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("uptime", "_uptime");
+entry("prof");
+entry("profread");
+entry("sysstat");
+entry("trace");
+entry("traceread");
+entry("ringsetup");
+entry("ring_enter");
+entry("perf");
+entry("getdents");
+entry("fstatat");
+entry("sendfile");
+entry("pread");
+entry("pwrite");
+entry("readv");
+entry("writev");
+entry("mmap");
+entry("munmap");
@@ -3,33 +3,42 @@
 #include "kernel/fcntl.h"
 #include "user/user.h"
 
-char buf[512];
-
 void
 wc(int fd, char *name)
 {
+  struct lreader lr;
   int i, n;
   int l, w, c, inword;
+  char *p;
 
+  if(lrinit(&lr, fd) < 0){
+    printf("wc: out of memory\n");
+    exit(1);
+  }
   l = w = c = 0;
   inword = 0;
-  while((n = read(fd, buf, sizeof(buf))) > 0){
+  while((p = lrline(&lr, &n)) != 0){
+    c += n;
+    if(p[n-1] == '\n')
+      l++;
     for(i=0; i<n; i++){
-      c++;
-      if(buf[i] == '\n')
-        l++;
-      if(strchr(" \r\t\n\v", buf[i]))
+      switch(p[i]){
+      case ' ': case '\r': case '\t': case '\n': case '\v':
         inword = 0;
-      else if(!inword){
-        w++;
-        inword = 1;
+        break;
+      default:
+        if(!inword){
+          w++;
+          inword = 1;
+        }
       }
     }
   }
-  if(n < 0){
+  if(lr.err){
     printf("wc: read error\n");
     exit(1);
   }
+  lrfree(&lr);
   printf("%d %d %d %s\n", l, w, c, name);
 }
 
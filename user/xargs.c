@@ -1,58 +1,159 @@
+// Run a command with arguments read from standard input.
+//
+//   xargs [-n lines] [-P procs] command [args...]
+//
+// Each line's words are appended to the command's arguments.
+// -n packs up to that many lines into one command (default 1),
+// as far as MAXARG allows; -P keeps up to that many commands
+// running at once (default 1).
+
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/param.h"
 
-int main(int argc, char *argv[]) {
-  char buf[512];
-  char *cmd[MAXARG];
-  int i;
-
-  // 复制命令参数
-  for(i = 1; i < argc && i < MAXARG-1; i++){
-    cmd[i-1] = argv[i];
-  }
-  int base = i-1; // 基础参数个数
-
-  // 逐行读取标准输入
-  int n = 0;
-  while(1){
-    n = 0;
-    char c;
-    // 读取一行
-    while(read(0, &c, 1) == 1 && c != '\n'){
-      if(n < sizeof(buf)-1)
-        buf[n++] = c;
-    }
-    if(n == 0 && c != '\n') // EOF
+#define STORESZ 4096      // bytes of words for one command
+
+char *cmd[MAXARG];
+int base;                 // arguments from our command line
+int argi;                 // next free slot in cmd
+char store[STORESZ];      // the words in cmd[base..argi)
+int nstore;
+int running, failed;
+
+void
+reap(void)
+{
+  int xstatus;
+
+  if(wait(&xstatus) < 0){
+    running = 0;
+    return;
+  }
+  running--;
+  if(xstatus != 0)
+    failed = 1;
+}
+
+// start the command with the arguments gathered so far,
+// first waiting for a child to finish if maxprocs are running.
+void
+run(int maxprocs)
+{
+  int pid;
+
+  if(argi == base)
+    return;
+  cmd[argi] = 0;
+  while(running >= maxprocs)
+    reap();
+  if((pid = fork()) < 0){
+    fprintf(2, "xargs: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(cmd[0], cmd);
+    fprintf(2, "xargs: exec %s failed\n", cmd[0]);
+    exit(1);
+  }
+  running++;
+  argi = base;
+  nstore = 0;
+}
+
+// is there room for a line of n characters holding words words?
+int
+fits(int words, int n)
+{
+  return argi + words < MAXARG && nstore + n + words <= STORESZ;
+}
+
+// append the words of the n-character line at p to cmd.
+void
+addline(char *p, int n)
+{
+  int i = 0, j;
+
+  while(i < n){
+    while(i < n && (p[i] == ' ' || p[i] == '\t' || p[i] == '\n'))
+      i++;
+    if(i == n)
       break;
-    buf[n] = 0;
-
-    // 构造参数
-    int argi = base;
-    int j = 0;
-    while(j < n){
-      // 跳过前导空格
-      while(buf[j] == ' ' || buf[j] == '\t') j++;
-      if(j >= n) break;
-      cmd[argi++] = &buf[j];
-      // 找到下一个空格或结尾
-      while(j < n && buf[j] != ' ' && buf[j] != '\t') j++;
-      buf[j++] = 0;
-      if(argi >= MAXARG-1) break;
-    }
-    cmd[argi] = 0;
+    for(j = i; j < n && p[j] != ' ' && p[j] != '\t' && p[j] != '\n'; j++)
+      ;
+    cmd[argi++] = store + nstore;
+    memmove(store + nstore, p + i, j - i);
+    nstore += j - i;
+    store[nstore++] = 0;
+    i = j;
+  }
+}
 
-    // fork+exec
-    if(fork() == 0){
-      exec(cmd[0], cmd);
-      fprintf(2, "exec failed\n");
-      exit(1);
+int
+countwords(char *p, int n)
+{
+  int i, words = 0, inword = 0;
+
+  for(i = 0; i < n; i++){
+    if(p[i] == ' ' || p[i] == '\t' || p[i] == '\n')
+      inword = 0;
+    else if(!inword){
+      words++;
+      inword = 1;
     }
-    wait(0);
+  }
+  return words;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct lreader lr;
+  int maxlines = 1, maxprocs = 1, lines = 0;
+  int i, n, words;
+  char *p;
 
-    if(c != '\n') // EOF
+  for(i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2){
+    if(strcmp(argv[i], "-n") == 0)
+      maxlines = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "-P") == 0)
+      maxprocs = atoi(argv[i+1]);
+    else
       break;
   }
-  exit(0);
-}
\ No newline at end of file
+  if(maxlines <= 0 || maxprocs <= 0 || i >= argc || argc - i >= MAXARG){
+    fprintf(2, "usage: xargs [-n lines] [-P procs] command [args...]\n");
+    exit(1);
+  }
+  for(; i < argc; i++)
+    cmd[base++] = argv[i];
+  argi = base;
+
+  if(lrinit(&lr, 0) < 0){
+    fprintf(2, "xargs: out of memory\n");
+    exit(1);
+  }
+  while((p = lrline(&lr, &n)) != 0){
+    if((words = countwords(p, n)) == 0)
+      continue;
+    if(!fits(words, n)){
+      run(maxprocs);
+      lines = 0;
+      if(!fits(words, n)){
+        fprintf(2, "xargs: line too long\n");
+        failed = 1;
+        continue;
+      }
+    }
+    addline(p, n);
+    if(++lines == maxlines){
+      run(maxprocs);
+      lines = 0;
+    }
+  }
+  run(maxprocs);
+  while(running > 0)
+    reap();
+  lrfree(&lr);
+  exit(failed);
+}